@@ -0,0 +1,185 @@
+#ifndef KRAYON_CORE_ANIMATION_EXECUTOR_HPP
+#define KRAYON_CORE_ANIMATION_EXECUTOR_HPP
+
+#include "commands.hpp"
+#include "work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace krayon::core {
+
+/// Time of one frame of a CmdAnimate
+struct FrameTime {
+    int index = 0;          ///< Frame number, from 0
+    double seconds = 0.0;   ///< index / frameRate
+    double progress = 0.0;  ///< Position in the animation, 0 to 1
+};
+
+/// Time of frame `index` of `animate`
+///
+/// A looping animation never shows its end state (it would repeat frame 0),
+/// so its progress runs to (totalFrames - 1) / totalFrames; otherwise the
+/// last frame has progress 1. Without a totalFrames the end is unknown and
+/// progress stays 0.
+inline FrameTime frame_time(const CmdAnimate& animate, int index) {
+    FrameTime time;
+    time.index = index;
+    time.seconds = index / animate.frameRate;
+    int steps = animate.loop ? animate.totalFrames : animate.totalFrames - 1;
+    time.progress = steps > 0 ? static_cast<double>(index) / steps : 0.0;
+    return time;
+}
+
+/// Renders the frames of a CmdAnimate concurrently, delivering them in order
+///
+/// `run` computes each frame's state on the calling thread with
+/// `state_at(time)`, which may therefore carry state from frame to frame,
+/// and renders it on the pool with `render(state, time)`. At most
+/// `max_in_flight` frames are admitted but not yet delivered; finished
+/// frames wait in a reorder buffer of that many slots until `sink(time,
+/// frame)` has taken every earlier frame, so memory stays bounded however
+/// far the fast frames get ahead of a slow one.
+///
+/// Only rendering runs in parallel: `state_at` and `sink` stay on the
+/// calling thread, so they bound the throughput however many workers the
+/// pool has.
+///
+/// The calling thread blocks while frames render, so `run` must not be
+/// called from a task of the same pool.
+template <typename State, typename Frame>
+class AnimationExecutor {
+public:
+    /// `max_in_flight` of 0 allows twice as many frames as pool workers
+    explicit AnimationExecutor(WorkStealingPool& pool, size_t max_in_flight = 0)
+        : pool(pool), window(max_in_flight > 0 ? max_in_flight : 2 * pool.size()) {}
+
+    size_t max_in_flight() const { return window; }
+
+    /// Render every frame of `animate`
+    ///
+    /// `sink` returns false to stop early. A totalFrames of 0 (auto-detect)
+    /// leaves the length to the caller: frames are rendered until `sink`
+    /// returns false, and up to `max_in_flight` frames past that one are
+    /// computed and discarded. An exception thrown by `render` stops the
+    /// animation and is rethrown here once the frames still rendering have
+    /// finished.
+    /// @return The number of frames passed to `sink`
+    template <typename StateFn, typename RenderFn, typename SinkFn>
+    int run(const CmdAnimate& animate, StateFn&& state_at, RenderFn&& render, SinkFn&& sink) {
+        if (animate.totalFrames < 0) {
+            throw std::invalid_argument("CmdAnimate needs a non-negative totalFrames");
+        }
+        if (!(animate.frameRate > 0.0)) {
+            throw std::invalid_argument("CmdAnimate needs a positive frameRate");
+        }
+
+        Buffer buffer(window);
+        // Outstanding renders reference `buffer` and `render`; wait for them
+        // on every way out, including exceptions from state_at and sink.
+        struct Drain {
+            Buffer& buffer;
+            ~Drain() {
+                std::unique_lock lock(buffer.mutex);
+                buffer.cancelled = true;
+                buffer.changed.wait(lock, [this] { return buffer.outstanding == 0; });
+            }
+        } drain{buffer};
+
+        auto admit = [&](int index) {
+            FrameTime time = frame_time(animate, index);
+            auto state = std::make_shared<const State>(state_at(time));
+            {
+                std::lock_guard lock(buffer.mutex);
+                ++buffer.outstanding;
+            }
+            pool.submit([&buffer, &render, state, time] {
+                Slot& slot = buffer.slots[static_cast<size_t>(time.index) % buffer.slots.size()];
+                std::optional<Frame> frame;
+                std::exception_ptr error;
+                if (!buffer.is_cancelled()) {
+                    try {
+                        frame.emplace(render(*state, time));
+                    } catch (...) {
+                        error = std::current_exception();
+                    }
+                }
+                std::lock_guard lock(buffer.mutex);
+                slot.frame = std::move(frame);
+                slot.error = error;
+                slot.ready = true;
+                --buffer.outstanding;
+                buffer.changed.notify_all();
+            });
+        };
+
+        int total = animate.totalFrames > 0 ? animate.totalFrames
+                                            : std::numeric_limits<int>::max();
+        int first = static_cast<int>(std::min<size_t>(window, static_cast<size_t>(total)));
+        for (int index = 0; index < first; ++index) {
+            admit(index);
+        }
+
+        int delivered = 0;
+        for (int index = 0; index < total; ++index) {
+            Slot& slot = buffer.slots[static_cast<size_t>(index) % window];
+            std::optional<Frame> frame;
+            {
+                std::unique_lock lock(buffer.mutex);
+                buffer.changed.wait(lock, [&slot] { return slot.ready; });
+                if (slot.error) {
+                    std::rethrow_exception(slot.error);
+                }
+                frame = std::move(slot.frame);
+                slot.frame.reset();
+                slot.ready = false;
+            }
+            ++delivered;
+            if (!sink(frame_time(animate, index), std::move(*frame))) {
+                break;
+            }
+            if (static_cast<size_t>(index) + window < static_cast<size_t>(total)) {
+                admit(index + static_cast<int>(window));
+            }
+        }
+        return delivered;
+    }
+
+private:
+    struct Slot {
+        std::optional<Frame> frame;
+        std::exception_ptr error;
+        bool ready = false;
+    };
+
+    /// Reorder buffer; slot `index % size` holds frame `index`
+    struct Buffer {
+        explicit Buffer(size_t size) : slots(size) {}
+
+        bool is_cancelled() {
+            std::lock_guard lock(mutex);
+            return cancelled;
+        }
+
+        std::vector<Slot> slots;
+        std::mutex mutex;
+        std::condition_variable changed;
+        size_t outstanding = 0;  ///< Submitted renders not yet finished
+        bool cancelled = false;
+    };
+
+    WorkStealingPool& pool;
+    size_t window;
+};
+
+}  // namespace krayon::core
+
+#endif  // KRAYON_CORE_ANIMATION_EXECUTOR_HPP
@@ -0,0 +1,669 @@
+#ifndef KRAYON_CORE_ASYNC_OUTPUT_HPP
+#define KRAYON_CORE_ASYNC_OUTPUT_HPP
+
+#include "frame_sink.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define KRAYON_CORE_HAS_ASYNC_OUTPUT 1
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(IO_URING_OP_SUPPORTED) && defined(IORING_FEAT_SINGLE_MMAP)
+#define KRAYON_CORE_HAS_IO_URING 1
+#endif
+#endif
+
+namespace krayon::core {
+
+#if defined(KRAYON_CORE_HAS_ASYNC_OUTPUT)
+
+/// Write-queue depth metrics of an AsyncWriteQueue
+struct WriteQueueStats {
+    size_t submitted = 0;    ///< Writes handed to the backend
+    size_t completed = 0;    ///< Writes fully on disk or in the pipe
+    size_t depth = 0;        ///< Writes in flight now
+    size_t max_depth = 0;    ///< Most writes in flight at once
+    uint64_t depth_sum = 0;  ///< Sum of the depth seen by each submission
+    size_t stalls = 0;       ///< Times a writer waited for a free buffer
+    size_t resubmits = 0;    ///< Short writes continued
+    uint64_t bytes = 0;      ///< Bytes written
+
+    /// Average number of writes in flight when a write was submitted
+    double mean_depth() const {
+        return submitted ? static_cast<double>(depth_sum) / static_cast<double>(submitted) : 0.0;
+    }
+};
+
+#if defined(KRAYON_CORE_HAS_IO_URING)
+
+/// Minimal io_uring instance, driven through the raw system calls
+///
+/// Only the thread that owns the queue submits and reaps.
+class IoUring {
+public:
+    explicit IoUring(unsigned entries) {
+        io_uring_params params{};
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return;
+        }
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !supports_write()) {
+            ::close(std::exchange(fd, -1));
+            return;
+        }
+        ring_size = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+                                     params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        ring = ::mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_SQ_RING);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void* mapped = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (ring == MAP_FAILED || mapped == MAP_FAILED) {
+            if (ring != MAP_FAILED) {
+                ::munmap(ring, ring_size);
+            }
+            ring = nullptr;
+            ::close(std::exchange(fd, -1));
+            return;
+        }
+        sqes = static_cast<io_uring_sqe*>(mapped);
+        auto* base = static_cast<char*>(ring);
+        sq_tail = reinterpret_cast<uint32_t*>(base + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<uint32_t*>(base + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<uint32_t*>(base + params.sq_off.array);
+        cq_head = reinterpret_cast<uint32_t*>(base + params.cq_off.head);
+        cq_tail = reinterpret_cast<uint32_t*>(base + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<uint32_t*>(base + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+    }
+
+    ~IoUring() {
+        if (fd >= 0) {
+            ::munmap(sqes, sqes_size);
+            ::munmap(ring, ring_size);
+            ::close(fd);
+        }
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /// False if the kernel has no io_uring or no IORING_OP_WRITE (before 5.6)
+    bool valid() const { return fd >= 0; }
+
+    /// Queue one write and submit it; `buffer` >= 0 selects a registered buffer
+    ///
+    /// The entry only stays in the submission ring if the kernel took it, so
+    /// a failed call leaves nothing behind to be submitted with a later one.
+    /// @return 0, or the errno of the failed submission
+    int write(int file, const uint8_t* data, uint32_t size, uint64_t offset, int buffer,
+              uint64_t user_data) {
+        uint32_t tail = *sq_tail;
+        uint32_t index = tail & sq_mask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = buffer >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe.fd = file;
+        sqe.off = offset;
+        sqe.addr = reinterpret_cast<uint64_t>(data);
+        sqe.len = size;
+        sqe.buf_index = static_cast<uint16_t>(std::max(buffer, 0));
+        sqe.user_data = user_data;
+        sq_array[index] = index;
+        std::atomic_ref<uint32_t>(*sq_tail).store(tail + 1, std::memory_order_release);
+        int submitted = 0;
+        do {
+            submitted = enter(1, 0, 0);
+        } while (submitted < 0 && errno == EINTR);
+        if (submitted == 1) {
+            return 0;
+        }
+        int status = submitted < 0 ? errno : EAGAIN;
+        // Without SQPOLL the kernel consumes entries only inside enter, and
+        // it consumed none; take the entry back.
+        std::atomic_ref<uint32_t>(*sq_tail).store(tail, std::memory_order_release);
+        return status;
+    }
+
+    /// Take a completion if there is one
+    bool complete(io_uring_cqe& out) {
+        uint32_t head = *cq_head;
+        if (head == std::atomic_ref<uint32_t>(*cq_tail).load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = cqes[head & cq_mask];
+        std::atomic_ref<uint32_t>(*cq_head).store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Block until a completion is available
+    /// @return false if the ring failed
+    bool wait() {
+        while (std::atomic_ref<uint32_t>(*cq_tail).load(std::memory_order_acquire) == *cq_head) {
+            if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool register_buffers(const std::vector<iovec>& buffers) {
+        return ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, buffers.data(),
+                         static_cast<unsigned>(buffers.size())) == 0;
+    }
+
+    void unregister_buffers() {
+        ::syscall(__NR_io_uring_register, fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    }
+
+private:
+    int fd = -1;
+    void* ring = nullptr;
+    size_t ring_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+    uint32_t* sq_tail = nullptr;
+    uint32_t sq_mask = 0;
+    uint32_t* sq_array = nullptr;
+    uint32_t* cq_head = nullptr;
+    uint32_t* cq_tail = nullptr;
+    uint32_t cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    int enter(unsigned submit, unsigned wait, unsigned flags) {
+        return static_cast<int>(
+            ::syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0));
+    }
+
+    bool supports_write() {
+        constexpr unsigned ops = 256;
+        std::vector<uint8_t> storage(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, ops) != 0) {
+            return false;
+        }
+        auto supported = [probe](unsigned op) {
+            return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+        return supported(IORING_OP_WRITE) && supported(IORING_OP_WRITE_FIXED);
+    }
+};
+
+#endif  // KRAYON_CORE_HAS_IO_URING
+
+/// Asynchronous writes from a fixed set of recycled buffers
+///
+/// The caller encodes into a buffer from acquire() and submit()s it; the
+/// write then proceeds while the caller encodes the next one, and the
+/// buffer is reused once the write completes. With io_uring (Linux 5.6+)
+/// the buffers are registered with the kernel, so writes skip the per-call
+/// page pinning; registration is redone when a buffer has to grow, and
+/// plain writes are used if it fails (e.g. over RLIMIT_MEMLOCK). Without
+/// io_uring, writes run on a ThreadPool with pwrite(). One queue can serve
+/// many outputs, such as the files of an image sequence.
+///
+/// acquire(), submit() and drain() must be called from one thread at a
+/// time; stats() may be called from any thread.
+class AsyncWriteQueue {
+public:
+    /// `depth` buffers, hence at most `depth` writes in flight
+    explicit AsyncWriteQueue(size_t depth = 4, bool use_io_uring = true)
+        : slots(std::max<size_t>(depth, 1)) {
+#if defined(KRAYON_CORE_HAS_IO_URING)
+        if (use_io_uring) {
+            uring = std::make_unique<IoUring>(static_cast<unsigned>(slots.size()));
+            if (!uring->valid()) {
+                uring.reset();
+            }
+        }
+#else
+        (void)use_io_uring;
+#endif
+        if (!uses_io_uring()) {
+            pool = std::make_unique<ThreadPool>(std::min<size_t>(slots.size(), 4));
+        }
+    }
+
+    /// Wait for every write; errors are dropped
+    ~AsyncWriteQueue() {
+        drain(nullptr);
+        pool.reset();
+#if defined(KRAYON_CORE_HAS_IO_URING)
+        if (registered) {
+            uring->unregister_buffers();
+        }
+#endif
+    }
+
+    AsyncWriteQueue(const AsyncWriteQueue&) = delete;
+    AsyncWriteQueue& operator=(const AsyncWriteQueue&) = delete;
+
+    bool uses_io_uring() const {
+#if defined(KRAYON_CORE_HAS_IO_URING)
+        return uring != nullptr;
+#else
+        return false;
+#endif
+    }
+
+    /// Whether writes currently use registered buffers
+    bool uses_registered_buffers() const {
+        std::lock_guard lock(mutex);
+        return registered;
+    }
+
+    WriteQueueStats stats() const {
+        std::lock_guard lock(mutex);
+        return counters;
+    }
+
+    /// A free buffer, waiting for a write to complete if all are in use
+    size_t acquire() {
+        std::unique_lock lock(mutex);
+        bool stalled = false;
+        while (true) {
+            for (size_t i = 0; i < slots.size(); ++i) {
+                if (!slots[i].busy) {
+                    slots[i].busy = true;
+                    slots[i].bytes.clear();
+                    counters.stalls += stalled;
+                    return i;
+                }
+            }
+            if (std::none_of(slots.begin(), slots.end(), [](const Slot& s) { return s.in_flight; })) {
+                throw std::logic_error("Every write buffer is acquired and none is being written");
+            }
+            stalled = true;
+            wait_for_completion(lock);
+        }
+    }
+
+    std::vector<uint8_t>& buffer(size_t slot) { return slots[slot].bytes; }
+
+    /// Give back an acquired buffer without writing it
+    void release(size_t slot) {
+        std::lock_guard lock(mutex);
+        slots[slot].busy = false;
+        changed.notify_all();
+    }
+
+    /// Write an acquired buffer to `fd` at `offset`, or at the current
+    /// position if there is none (pipes; keep one such write in flight)
+    void submit(size_t slot, const void* owner, int fd, std::optional<uint64_t> offset) {
+        std::unique_lock lock(mutex);
+        Slot& s = slots[slot];
+        if (s.bytes.empty()) {
+            s.busy = false;
+            return;
+        }
+        s.owner = owner;
+        s.fd = fd;
+        s.offset = offset;
+        s.done = 0;
+        s.in_flight = true;
+        ++counters.submitted;
+        ++counters.depth;
+        counters.max_depth = std::max(counters.max_depth, counters.depth);
+        counters.depth_sum += counters.depth;
+#if defined(KRAYON_CORE_HAS_IO_URING)
+        if (uring) {
+            if (!registration_failed && !matches_registration(slot)) {
+                reregister(lock);
+            }
+            start(slot);
+            return;
+        }
+#endif
+        pool->submit([this, slot] { write_blocking(slot); });
+    }
+
+    /// Wait until no write of `owner` (of anyone, for nullptr) is in flight
+    void drain(const void* owner) {
+        std::unique_lock lock(mutex);
+        auto pending = [&] {
+            return std::any_of(slots.begin(), slots.end(), [owner](const Slot& s) {
+                return s.in_flight && (!owner || s.owner == owner);
+            });
+        };
+        while (pending()) {
+            wait_for_completion(lock);
+        }
+    }
+
+    /// Throw the first write error, if any
+    void check() const {
+        std::lock_guard lock(mutex);
+        if (error != 0) {
+            throw std::runtime_error(std::string("Cannot write frame output: ") +
+                                     std::strerror(error));
+        }
+    }
+
+private:
+    struct Slot {
+        std::vector<uint8_t> bytes;
+        const void* owner = nullptr;
+        int fd = -1;
+        std::optional<uint64_t> offset;
+        size_t done = 0;         ///< Bytes written so far
+        bool busy = false;       ///< Acquired or in flight
+        bool in_flight = false;
+    };
+
+    std::vector<Slot> slots;
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    WriteQueueStats counters;
+    int error = 0;  ///< First errno
+    bool registered = false;
+    bool registration_failed = false;
+    std::unique_ptr<ThreadPool> pool;
+#if defined(KRAYON_CORE_HAS_IO_URING)
+    std::unique_ptr<IoUring> uring;
+    std::vector<iovec> registration;
+#endif
+
+    /// Account a finished write; called with the lock held
+    void finish(size_t slot, int errno_value) {
+        Slot& s = slots[slot];
+        if (errno_value != 0 && error == 0) {
+            error = errno_value;
+        }
+        s.in_flight = false;
+        s.busy = false;
+        --counters.depth;
+        ++counters.completed;
+        counters.bytes += s.done;
+        changed.notify_all();
+    }
+
+    void wait_for_completion(std::unique_lock<std::mutex>& lock) {
+#if defined(KRAYON_CORE_HAS_IO_URING)
+        if (uring) {
+            reap(lock);
+            return;
+        }
+#endif
+        size_t completed = counters.completed;
+        changed.wait(lock, [&] { return counters.completed != completed; });
+    }
+
+    void write_blocking(size_t slot) {
+        Slot& s = slots[slot];
+        int status = 0;
+        while (s.done < s.bytes.size()) {
+            const uint8_t* data = s.bytes.data() + s.done;
+            size_t size = s.bytes.size() - s.done;
+            ssize_t written = s.offset ? ::pwrite(s.fd, data, size, static_cast<off_t>(*s.offset + s.done))
+                                       : ::write(s.fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                status = errno;
+                break;
+            }
+            s.done += static_cast<size_t>(written);
+        }
+        std::lock_guard lock(mutex);
+        finish(slot, status);
+    }
+
+#if defined(KRAYON_CORE_HAS_IO_URING)
+    void start(size_t slot) {
+        Slot& s = slots[slot];
+        auto size = static_cast<uint32_t>(std::min<size_t>(s.bytes.size() - s.done, 1u << 30));
+        uint64_t offset = s.offset ? *s.offset + s.done : ~uint64_t{0};
+        int status = uring->write(s.fd, s.bytes.data() + s.done, size, offset,
+                                  registered ? static_cast<int>(slot) : -1, slot);
+        if (status != 0) {
+            finish(slot, status);
+        }
+    }
+
+    /// Wait for completions and handle them; stats() stays available
+    /// while this thread blocks in the kernel
+    void reap(std::unique_lock<std::mutex>& lock) {
+        lock.unlock();
+        bool alive = uring->wait();
+        lock.lock();
+        if (!alive) {
+            // Nothing would ever complete; fail what is in flight.
+            for (size_t i = 0; i < slots.size(); ++i) {
+                if (slots[i].in_flight) {
+                    finish(i, EIO);
+                }
+            }
+            return;
+        }
+        io_uring_cqe cqe{};
+        while (uring->complete(cqe)) {
+            auto slot = static_cast<size_t>(cqe.user_data);
+            Slot& s = slots[slot];
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                ++counters.resubmits;
+                start(slot);
+            } else if (cqe.res < 0) {
+                finish(slot, -cqe.res);
+            } else if (cqe.res == 0 && s.done < s.bytes.size()) {
+                finish(slot, EIO);
+            } else {
+                s.done += static_cast<size_t>(cqe.res);
+                if (s.done < s.bytes.size()) {
+                    ++counters.resubmits;
+                    start(slot);
+                } else {
+                    finish(slot, 0);
+                }
+            }
+        }
+    }
+
+    bool matches_registration(size_t slot) const {
+        const Slot& s = slots[slot];
+        return registered && registration[slot].iov_base == s.bytes.data() &&
+               registration[slot].iov_len >= s.bytes.size();
+    }
+
+    /// Register every buffer with room for the largest write so far
+    void reregister(std::unique_lock<std::mutex>& lock) {
+        auto others_in_flight = [&] {
+            size_t count = 0;
+            for (const Slot& s : slots) {
+                count += s.in_flight;
+            }
+            return count > 1;  // The slot being submitted is marked already
+        };
+        while (others_in_flight()) {
+            wait_for_completion(lock);
+        }
+        if (registered) {
+            uring->unregister_buffers();
+            registered = false;
+        }
+        size_t capacity = 0;
+        for (const Slot& s : slots) {
+            capacity = std::max(capacity, s.bytes.size());
+        }
+        capacity += capacity / 4;  // Headroom, so slightly larger frames fit
+        registration.resize(slots.size());
+        for (size_t i = 0; i < slots.size(); ++i) {
+            slots[i].bytes.reserve(capacity);
+            registration[i] = {slots[i].bytes.data(), slots[i].bytes.capacity()};
+        }
+        registered = uring->register_buffers(registration);
+        registration_failed = !registered;
+    }
+#endif
+};
+
+/// FrameOutput whose writes go through an AsyncWriteQueue
+///
+/// Paths are interpreted as by FileOutput, and likewise a pipe into an
+/// encoder is passed as a descriptor. Sinks that encode into staging() hand
+/// the queue's buffer over without a copy; write() copies into one. Writes
+/// to stdout and pipes are kept in order by allowing one in flight at a
+/// time.
+class AsyncOutput : public FrameOutput {
+public:
+    AsyncOutput(std::shared_ptr<AsyncWriteQueue> queue, const std::string& path)
+        : queue(std::move(queue)), path(path) {
+        if (path == "-") {
+            fd = STDOUT_FILENO;
+            owned = false;
+        } else {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        }
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open frame output: " + path);
+        }
+        detect_seekable();
+    }
+
+    /// Write to an open file descriptor, which the output then owns and
+    /// closes; `name` only appears in error messages
+    AsyncOutput(std::shared_ptr<AsyncWriteQueue> queue, int fd, std::string name)
+        : queue(std::move(queue)), path(std::move(name)), fd(fd) {
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open frame output: " + path);
+        }
+        detect_seekable();
+    }
+
+    ~AsyncOutput() override {
+        if (staged) {
+            queue->release(*staged);
+        }
+        if (fd >= 0) {
+            queue->drain(this);
+            finish();
+        }
+    }
+
+    AsyncOutput(const AsyncOutput&) = delete;
+    AsyncOutput& operator=(const AsyncOutput&) = delete;
+
+    void write(const uint8_t* data, size_t size) override {
+        std::vector<uint8_t>& bytes = staging();
+        bytes.assign(data, data + size);
+        write_staged();
+    }
+
+    std::vector<uint8_t>& staging() override {
+        if (!staged) {
+            queue->check();
+            staged = queue->acquire();
+        }
+        std::vector<uint8_t>& bytes = queue->buffer(*staged);
+        bytes.clear();
+        return bytes;
+    }
+
+    void write_staged() override {
+        if (!staged) {
+            return;
+        }
+        size_t slot = *std::exchange(staged, std::nullopt);
+        size_t size = queue->buffer(slot).size();
+        if (!seekable) {
+            queue->drain(this);
+        }
+        queue->submit(slot, this, fd, seekable ? std::optional<uint64_t>(written) : std::nullopt);
+        written += size;
+    }
+
+    bool patch(uint64_t offset, const uint8_t* data, size_t size) override {
+        if (!seekable) {
+            return false;
+        }
+        queue->drain(this);
+        while (size > 0) {
+            ssize_t count = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            data += count;
+            offset += static_cast<uint64_t>(count);
+            size -= static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    uint64_t position() const override { return written; }
+
+    void close() override {
+        if (fd < 0) {
+            return;
+        }
+        queue->drain(this);
+        bool ok = finish();
+        queue->check();
+        if (!ok) {
+            throw std::runtime_error("Cannot write frame output: " + path);
+        }
+    }
+
+private:
+    std::shared_ptr<AsyncWriteQueue> queue;
+    std::string path;
+    int fd = -1;
+    bool owned = true;
+    bool seekable = false;
+    uint64_t written = 0;
+    std::optional<size_t> staged;  ///< Buffer handed out by staging()
+
+    void detect_seekable() {
+        struct stat info {};
+        seekable = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+    }
+
+    bool finish() {
+        int closing = std::exchange(fd, -1);
+        return !owned || ::close(closing) == 0;
+    }
+};
+
+/// OutputFactory writing through `queue`, for open_frame_sink()
+///
+///     auto queue = std::make_shared<AsyncWriteQueue>(8);
+///     FrameWriter writer(open_frame_sink(animate, async_output_factory(queue)));
+///     ...
+///     WriteQueueStats stats = queue->stats();
+inline OutputFactory async_output_factory(std::shared_ptr<AsyncWriteQueue> queue) {
+    return [queue = std::move(queue)](const std::string& path) -> std::unique_ptr<FrameOutput> {
+        return std::make_unique<AsyncOutput>(queue, path);
+    };
+}
+
+#endif  // KRAYON_CORE_HAS_ASYNC_OUTPUT
+
+}  // namespace krayon::core
+
+#endif  // KRAYON_CORE_ASYNC_OUTPUT_HPP
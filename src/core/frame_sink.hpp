@@ -0,0 +1,776 @@
+#ifndef KRAYON_CORE_FRAME_SINK_HPP
+#define KRAYON_CORE_FRAME_SINK_HPP
+
+#include "commands.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace krayon::core {
+
+/// Rendered frame: 8-bit RGBA, rows top to bottom, no padding
+struct FrameBuffer {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;  ///< width * height * 4 bytes
+
+    /// Set the size, keeping the allocation when it is large enough
+    void resize(int new_width, int new_height) {
+        width = new_width;
+        height = new_height;
+        pixels.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 4);
+    }
+};
+
+/// Destination of one encoded byte stream (a file, stdout or a pipe)
+class FrameOutput {
+public:
+    virtual ~FrameOutput() = default;
+
+    /// Append bytes; throws std::runtime_error if they cannot be written
+    virtual void write(const uint8_t* data, size_t size) = 0;
+
+    /// Overwrite bytes written earlier
+    /// @return false if the output cannot seek
+    virtual bool patch(uint64_t offset, const uint8_t* data, size_t size) {
+        (void)offset;
+        (void)data;
+        (void)size;
+        return false;
+    }
+
+    /// Bytes written so far
+    virtual uint64_t position() const = 0;
+
+    /// Flush and close; throws std::runtime_error on failure
+    virtual void close() = 0;
+
+    void write(const std::vector<uint8_t>& bytes) { write(bytes.data(), bytes.size()); }
+
+    /// Empty buffer to encode the next write into, then write_staged();
+    /// outputs that write asynchronously hand out their own buffers
+    virtual std::vector<uint8_t>& staging() {
+        staged.clear();
+        return staged;
+    }
+
+    /// Write the buffer filled through staging()
+    virtual void write_staged() { write(staged); }
+
+private:
+    std::vector<uint8_t> staged;
+};
+
+/// Opens the output for a path; sinks writing sequences open one per frame
+using OutputFactory = std::function<std::unique_ptr<FrameOutput>(const std::string&)>;
+
+/// Output through stdio
+///
+/// "-" is stdout; any other path is a file. Paths never start a process: to
+/// stream into an encoder, start it yourself (without a shell) and pass the
+/// write end of its stdin pipe to the descriptor constructor, for example
+/// from the OutputFactory given to open_frame_sink(). Only seekable
+/// outputs can patch.
+class FileOutput : public FrameOutput {
+public:
+    explicit FileOutput(const std::string& path) : path(path) {
+        if (path == "-") {
+            file = stdout;
+            owned = false;
+        } else {
+            file = std::fopen(path.c_str(), "wb");
+        }
+        if (!file) {
+            throw std::runtime_error("Cannot open frame output: " + path);
+        }
+        if (owned) {
+            std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        }
+    }
+
+    /// Write to an open file descriptor, which the output then owns and
+    /// closes; `name` only appears in error messages
+    FileOutput(int fd, std::string name) : path(std::move(name)) {
+#if defined(__unix__) || defined(__APPLE__)
+        file = ::fdopen(fd, "wb");
+#else
+        (void)fd;
+#endif
+        if (!file) {
+            throw std::runtime_error("Cannot open frame output: " + path);
+        }
+        std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    }
+
+    ~FileOutput() override {
+        if (file && owned) {
+            finish();
+        }
+    }
+
+    FileOutput(const FileOutput&) = delete;
+    FileOutput& operator=(const FileOutput&) = delete;
+
+    void write(const uint8_t* data, size_t size) override {
+        if (std::fwrite(data, 1, size, file) != size) {
+            throw std::runtime_error("Cannot write frame output: " + path);
+        }
+        written += size;
+    }
+
+    bool patch(uint64_t offset, const uint8_t* data, size_t size) override {
+        if (!owned || std::fflush(file) != 0 ||
+            std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0) {
+            return false;
+        }
+        bool ok = std::fwrite(data, 1, size, file) == size;
+        return std::fseek(file, 0, SEEK_END) == 0 && ok;
+    }
+
+    uint64_t position() const override { return written; }
+
+    void close() override {
+        if (!file) {
+            return;
+        }
+        bool ok = std::fflush(file) == 0;
+        if (owned) {
+            ok = finish() && ok;
+        }
+        file = nullptr;
+        if (!ok) {
+            throw std::runtime_error("Cannot write frame output: " + path);
+        }
+    }
+
+private:
+    std::string path;
+    std::FILE* file = nullptr;
+    bool owned = true;
+    uint64_t written = 0;
+
+    bool finish() { return std::fclose(std::exchange(file, nullptr)) == 0; }
+};
+
+/// Default OutputFactory
+inline std::unique_ptr<FrameOutput> open_file_output(const std::string& path) {
+    return std::make_unique<FileOutput>(path);
+}
+
+namespace detail {
+
+inline void put_be32(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline void put_text(std::vector<uint8_t>& out, const std::string& text) {
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+/// Frame rate as a reduced fraction with a denominator of at most 1000
+inline std::pair<uint32_t, uint32_t> rate_fraction(double fps) {
+    auto num = static_cast<uint32_t>(std::llround(fps * 1000.0));
+    uint32_t den = 1000;
+    uint32_t divisor = std::gcd(num, den);
+    return divisor ? std::pair{num / divisor, den / divisor} : std::pair{num, den};
+}
+
+/// CRC-32 as used by PNG
+inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static constexpr auto table = [] {
+        std::array<uint32_t, 256> entries{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+        return entries;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline uint32_t adler32(const uint8_t* data, size_t size) {
+    uint32_t a = 1;
+    uint32_t b = 0;
+    while (size > 0) {
+        size_t block = std::min<size_t>(size, 5552);  // Largest run without overflow
+        for (size_t i = 0; i < block; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+/// zlib stream of one fixed-Huffman deflate block
+///
+/// Matches are looked for at the last position with the same three bytes,
+/// one pixel back and one row back, which covers the flat and repeated
+/// regions typical of rendered frames without a full hash chain.
+inline void zlib_compress(const uint8_t* data, size_t size, size_t row, std::vector<uint8_t>& out) {
+    static constexpr uint16_t length_base[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11, 13,
+                                                 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+                                                 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static constexpr uint8_t length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static constexpr uint16_t distance_base[30] = {
+        1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+        193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static constexpr uint8_t distance_extra[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,  4,  4,  5,  5,  6,
+                                                   6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    constexpr size_t window = 32768;
+    constexpr size_t max_match = 258;
+    constexpr int hash_bits = 15;
+
+    uint64_t bits = 0;
+    int count = 0;
+    auto put = [&](uint32_t value, int length) {
+        bits |= static_cast<uint64_t>(value) << count;
+        count += length;
+        while (count >= 8) {
+            out.push_back(static_cast<uint8_t>(bits));
+            bits >>= 8;
+            count -= 8;
+        }
+    };
+    auto put_code = [&](uint32_t code, int length) {  // Huffman codes go MSB first
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put(reversed, length);
+    };
+    auto put_symbol = [&](int symbol) {
+        if (symbol < 144) {
+            put_code(0x30 + symbol, 8);
+        } else if (symbol < 256) {
+            put_code(0x190 + symbol - 144, 9);
+        } else if (symbol < 280) {
+            put_code(symbol - 256, 7);
+        } else {
+            put_code(0xC0 + symbol - 280, 8);
+        }
+    };
+    auto hash = [data](size_t i) {
+        uint32_t key = (uint32_t{data[i]} << 16) | (uint32_t{data[i + 1]} << 8) | data[i + 2];
+        return (key * 2654435761u) >> (32 - hash_bits);
+    };
+
+    out.push_back(0x78);  // Deflate, 32K window
+    out.push_back(0x01);
+    put(1, 1);            // Final block
+    put(1, 2);            // Fixed Huffman codes
+
+    std::vector<int64_t> last(size_t{1} << hash_bits, -1);
+    size_t i = 0;
+    while (i < size) {
+        size_t best_length = 0;
+        size_t best_distance = 0;
+        if (i + 3 <= size) {
+            size_t limit = std::min(max_match, size - i);
+            auto try_at = [&](size_t candidate) {
+                size_t distance = i - candidate;
+                if (distance == 0 || distance > window) {
+                    return;
+                }
+                size_t length = 0;
+                while (length < limit && data[candidate + length] == data[i + length]) {
+                    ++length;
+                }
+                if (length > best_length) {
+                    best_length = length;
+                    best_distance = distance;
+                }
+            };
+            uint32_t h = hash(i);
+            if (last[h] >= 0) {
+                try_at(static_cast<size_t>(last[h]));
+            }
+            if (i >= 4 && best_length < limit) {
+                try_at(i - 4);
+            }
+            if (i >= row && best_length < limit) {
+                try_at(i - row);
+            }
+            last[h] = static_cast<int64_t>(i);
+        }
+
+        if (best_length < 3) {
+            put_symbol(data[i]);
+            ++i;
+            continue;
+        }
+        int code = static_cast<int>(std::upper_bound(length_base, length_base + 29, best_length) -
+                                    length_base) - 1;
+        put_symbol(257 + code);
+        put(static_cast<uint32_t>(best_length - length_base[code]), length_extra[code]);
+        code = static_cast<int>(std::upper_bound(distance_base, distance_base + 30, best_distance) -
+                                distance_base) - 1;
+        put_code(static_cast<uint32_t>(code), 5);
+        put(static_cast<uint32_t>(best_distance - distance_base[code]), distance_extra[code]);
+        for (size_t end = i + best_length, k = i + 1; k < end && k + 3 <= size; ++k) {
+            last[hash(k)] = static_cast<int64_t>(k);
+        }
+        i += best_length;
+    }
+    put_symbol(256);
+    if (count > 0) {
+        out.push_back(static_cast<uint8_t>(bits));
+    }
+    put_be32(out, adler32(data, size));
+}
+
+/// Encode `frame` as a QOI image
+inline void encode_qoi(const FrameBuffer& frame, std::vector<uint8_t>& out) {
+    struct Pixel {
+        uint8_t r = 0, g = 0, b = 0, a = 0;
+        bool operator==(const Pixel&) const = default;
+    };
+    put_text(out, "qoif");
+    put_be32(out, static_cast<uint32_t>(frame.width));
+    put_be32(out, static_cast<uint32_t>(frame.height));
+    out.push_back(4);  // RGBA
+    out.push_back(0);  // sRGB with linear alpha
+
+    std::array<Pixel, 64> seen{};
+    Pixel previous{0, 0, 0, 255};
+    int run = 0;
+    size_t count = frame.pixels.size() / 4;
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* p = &frame.pixels[i * 4];
+        Pixel pixel{p[0], p[1], p[2], p[3]};
+        if (pixel == previous) {
+            if (++run == 62 || i + 1 == count) {
+                out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+            run = 0;
+        }
+        size_t slot = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+        if (seen[slot] == pixel) {
+            out.push_back(static_cast<uint8_t>(slot));
+        } else {
+            seen[slot] = pixel;
+            if (pixel.a == previous.a) {
+                int dr = static_cast<int8_t>(pixel.r - previous.r);
+                int dg = static_cast<int8_t>(pixel.g - previous.g);
+                int db = static_cast<int8_t>(pixel.b - previous.b);
+                int dr_dg = dr - dg;
+                int db_dg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out.push_back(static_cast<uint8_t>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 &&
+                           db_dg <= 7) {
+                    out.push_back(static_cast<uint8_t>(0x80 | (dg + 32)));
+                    out.push_back(static_cast<uint8_t>((dr_dg + 8) << 4 | (db_dg + 8)));
+                } else {
+                    out.insert(out.end(), {0xFE, pixel.r, pixel.g, pixel.b});
+                }
+            } else {
+                out.insert(out.end(), {0xFF, pixel.r, pixel.g, pixel.b, pixel.a});
+            }
+        }
+        previous = pixel;
+    }
+    out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+}  // namespace detail
+
+/// Consumer of the frames of one animation, in order
+///
+/// Sinks encode straight from the FrameBuffer they are given and keep no
+/// reference to it after write() returns. All frames must have the size
+/// of the first one.
+class FrameSink {
+public:
+    virtual ~FrameSink() = default;
+
+    /// Encode and write the next frame; throws on I/O or size errors
+    virtual void write(const FrameBuffer& frame) = 0;
+
+    /// Write any trailer and close the output
+    virtual void finish() = 0;
+
+    /// Frames written so far
+    size_t frame_count() const { return frames; }
+
+protected:
+    int width = 0;
+    int height = 0;
+    size_t frames = 0;
+
+    /// Remember the first frame's size and reject any other
+    void check_size(const FrameBuffer& frame) {
+        if (frame.pixels.size() != static_cast<size_t>(frame.width) * frame.height * 4) {
+            throw std::invalid_argument("FrameBuffer pixels do not match its size");
+        }
+        if (frames == 0) {
+            width = frame.width;
+            height = frame.height;
+        } else if (frame.width != width || frame.height != height) {
+            throw std::invalid_argument("Frame size changed during the animation");
+        }
+    }
+};
+
+/// Unframed RGBA bytes, for `ffmpeg -f rawvideo -pix_fmt rgba`
+class RawRgbaSink : public FrameSink {
+public:
+    explicit RawRgbaSink(std::unique_ptr<FrameOutput> output) : output(std::move(output)) {}
+
+    void write(const FrameBuffer& frame) override {
+        check_size(frame);
+        output->write(frame.pixels);
+        ++frames;
+    }
+
+    void finish() override { output->close(); }
+
+private:
+    std::unique_ptr<FrameOutput> output;
+};
+
+/// YUV4MPEG2 stream (full-resolution 4:4:4 chroma, BT.601 studio range)
+class Y4mSink : public FrameSink {
+public:
+    Y4mSink(std::unique_ptr<FrameOutput> output, double fps) : output(std::move(output)), fps(fps) {}
+
+    void write(const FrameBuffer& frame) override {
+        check_size(frame);
+        std::vector<uint8_t>& bytes = output->staging();
+        if (frames == 0) {
+            auto [num, den] = detail::rate_fraction(fps);
+            detail::put_text(bytes, "YUV4MPEG2 W" + std::to_string(width) + " H" +
+                                        std::to_string(height) + " F" + std::to_string(num) +
+                                        ":" + std::to_string(den) + " Ip A1:1 C444\n");
+        }
+        detail::put_text(bytes, "FRAME\n");
+        size_t plane = static_cast<size_t>(width) * height;
+        size_t start = bytes.size();
+        bytes.resize(start + plane * 3);
+        uint8_t* y = bytes.data() + start;
+        uint8_t* u = y + plane;
+        uint8_t* v = u + plane;
+        const uint8_t* p = frame.pixels.data();
+        for (size_t i = 0; i < plane; ++i, p += 4) {
+            int r = p[0], g = p[1], b = p[2];
+            y[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            u[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+        output->write_staged();
+        ++frames;
+    }
+
+    void finish() override { output->close(); }
+
+private:
+    std::unique_ptr<FrameOutput> output;
+    double fps;
+};
+
+/// One image file per frame, named by a printf-style `%d` or `%0Nd` pattern
+///
+/// The outputs of the last few frames stay open, so an asynchronous output
+/// keeps writing a frame while the next ones are encoded; finish() closes
+/// them.
+class ImageSequenceSink : public FrameSink {
+public:
+    /// Written frames whose outputs are not closed yet
+    static constexpr size_t open_outputs = 4;
+
+    enum class Format {
+        Ppm,  ///< Binary PPM (P6); alpha is dropped
+        Qoi
+    };
+
+    ImageSequenceSink(std::string pattern, Format format, OutputFactory open = open_file_output)
+        : pattern(std::move(pattern)), format(format), open(std::move(open)) {
+        size_t percent = this->pattern.find('%');
+        size_t end = percent == std::string::npos
+                         ? percent
+                         : this->pattern.find_first_not_of("0123456789", percent + 1);
+        if (end == std::string::npos || this->pattern[end] != 'd' ||
+            this->pattern.find('%', end) != std::string::npos) {
+            throw std::invalid_argument("Image sequence needs one %d in its path: " +
+                                        this->pattern);
+        }
+        prefix = this->pattern.substr(0, percent);
+        suffix = this->pattern.substr(end + 1);
+        digits = percent + 1 < end ? std::stoi(this->pattern.substr(percent + 1, end - percent - 1))
+                                   : 0;
+    }
+
+    /// Path of frame `index`
+    std::string path_for(size_t index) const {
+        std::string number = std::to_string(index);
+        if (number.size() < static_cast<size_t>(digits)) {
+            number.insert(0, static_cast<size_t>(digits) - number.size(), '0');
+        }
+        return prefix + number + suffix;
+    }
+
+    void write(const FrameBuffer& frame) override {
+        check_size(frame);
+        std::unique_ptr<FrameOutput> output = open(path_for(frames));
+        std::vector<uint8_t>& bytes = output->staging();
+        if (format == Format::Qoi) {
+            detail::encode_qoi(frame, bytes);
+        } else {
+            detail::put_text(bytes, "P6\n" + std::to_string(width) + " " +
+                                        std::to_string(height) + "\n255\n");
+            size_t count = frame.pixels.size() / 4;
+            size_t start = bytes.size();
+            bytes.resize(start + count * 3);
+            uint8_t* rgb = bytes.data() + start;
+            for (size_t i = 0; i < count; ++i) {
+                rgb[i * 3 + 0] = frame.pixels[i * 4 + 0];
+                rgb[i * 3 + 1] = frame.pixels[i * 4 + 1];
+                rgb[i * 3 + 2] = frame.pixels[i * 4 + 2];
+            }
+        }
+        output->write_staged();
+        pending.push_back(std::move(output));
+        ++frames;
+        if (pending.size() > open_outputs) {
+            close_oldest();
+        }
+    }
+
+    void finish() override {
+        while (!pending.empty()) {
+            close_oldest();
+        }
+    }
+
+private:
+    std::string pattern;
+    Format format;
+    OutputFactory open;
+    std::string prefix;
+    std::string suffix;
+    int digits = 0;
+    std::deque<std::unique_ptr<FrameOutput>> pending;  ///< Oldest first
+
+    void close_oldest() {
+        std::unique_ptr<FrameOutput> oldest = std::move(pending.front());
+        pending.pop_front();
+        oldest->close();
+    }
+};
+
+/// Animated PNG in a single file
+///
+/// The frame count is declared up front from the expected number of
+/// frames and patched in finish() if the animation stopped early, which
+/// needs a seekable output.
+class ApngSink : public FrameSink {
+public:
+    ApngSink(std::unique_ptr<FrameOutput> output, double fps, uint32_t expected_frames, bool loop)
+        : output(std::move(output)), fps(fps), declared(expected_frames), loop(loop) {}
+
+    void write(const FrameBuffer& frame) override {
+        check_size(frame);
+        std::vector<uint8_t>& bytes = output->staging();
+        if (frames == 0) {
+            write_header(bytes);
+        }
+
+        size_t row = static_cast<size_t>(width) * 4;
+        scanlines.resize((row + 1) * height);
+        for (int y = 0; y < height; ++y) {
+            scanlines[y * (row + 1)] = 0;  // Filter: none
+            std::copy_n(frame.pixels.data() + y * row, row, scanlines.data() + y * (row + 1) + 1);
+        }
+
+        size_t chunk = begin_chunk(bytes, "fcTL");
+        detail::put_be32(bytes, sequence++);
+        detail::put_be32(bytes, static_cast<uint32_t>(width));
+        detail::put_be32(bytes, static_cast<uint32_t>(height));
+        detail::put_be32(bytes, 0);  // x offset
+        detail::put_be32(bytes, 0);  // y offset
+        auto [delay_num, delay_den] = delay();
+        bytes.insert(bytes.end(), {static_cast<uint8_t>(delay_num >> 8),
+                                   static_cast<uint8_t>(delay_num),
+                                   static_cast<uint8_t>(delay_den >> 8),
+                                   static_cast<uint8_t>(delay_den), 0, 0});
+        end_chunk(bytes, chunk);
+
+        // Compressed straight into the chunk, so the data is never copied
+        chunk = begin_chunk(bytes, frames == 0 ? "IDAT" : "fdAT");
+        if (frames > 0) {
+            detail::put_be32(bytes, sequence++);
+        }
+        detail::zlib_compress(scanlines.data(), scanlines.size(), row + 1, bytes);
+        end_chunk(bytes, chunk);
+        output->write_staged();
+        ++frames;
+    }
+
+    void finish() override {
+        if (frames > 0) {
+            std::vector<uint8_t>& bytes = output->staging();
+            end_chunk(bytes, begin_chunk(bytes, "IEND"));
+            output->write_staged();
+            if (frames != declared) {
+                std::vector<uint8_t> chunk;
+                put_chunk(chunk, "acTL", animation_control(static_cast<uint32_t>(frames)));
+                if (!output->patch(animation_offset, chunk.data(), chunk.size())) {
+                    throw std::runtime_error("Cannot correct the APNG frame count on this output");
+                }
+            }
+        }
+        output->close();
+    }
+
+private:
+    std::unique_ptr<FrameOutput> output;
+    double fps;
+    uint32_t declared;
+    bool loop;
+    uint32_t sequence = 0;
+    uint64_t animation_offset = 0;
+    std::vector<uint8_t> scanlines;
+
+    /// Start a chunk; end_chunk() fills in its length and appends the CRC
+    static size_t begin_chunk(std::vector<uint8_t>& out, const char* type) {
+        size_t start = out.size();
+        detail::put_be32(out, 0);
+        out.insert(out.end(), type, type + 4);
+        return start;
+    }
+
+    static void end_chunk(std::vector<uint8_t>& out, size_t start) {
+        auto length = static_cast<uint32_t>(out.size() - start - 8);
+        for (int i = 0; i < 4; ++i) {
+            out[start + i] = static_cast<uint8_t>(length >> (24 - 8 * i));
+        }
+        detail::put_be32(out, detail::crc32(out.data() + start + 4, out.size() - start - 4));
+    }
+
+    static void put_chunk(std::vector<uint8_t>& out, const char* type,
+                          const std::vector<uint8_t>& data) {
+        size_t start = begin_chunk(out, type);
+        out.insert(out.end(), data.begin(), data.end());
+        end_chunk(out, start);
+    }
+
+    std::vector<uint8_t> animation_control(uint32_t count) const {
+        std::vector<uint8_t> data;
+        detail::put_be32(data, count);
+        detail::put_be32(data, loop ? 0 : 1);  // Plays; 0 repeats forever
+        return data;
+    }
+
+    /// Frame delay in seconds as a 16-bit fraction
+    std::pair<uint32_t, uint32_t> delay() const {
+        auto [num, den] = detail::rate_fraction(fps);
+        if (num <= 0xFFFF && den <= 0xFFFF) {
+            return {den, num};
+        }
+        return {std::min<uint32_t>(0xFFFF, static_cast<uint32_t>(std::lround(1000.0 / fps))), 1000};
+    }
+
+    void write_header(std::vector<uint8_t>& bytes) {
+        bytes.insert(bytes.end(), {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'});
+        std::vector<uint8_t> header;
+        detail::put_be32(header, static_cast<uint32_t>(width));
+        detail::put_be32(header, static_cast<uint32_t>(height));
+        header.insert(header.end(), {8, 6, 0, 0, 0});  // 8-bit RGBA, no interlace
+        put_chunk(bytes, "IHDR", header);
+        animation_offset = output->position() + bytes.size();
+        put_chunk(bytes, "acTL", animation_control(declared));
+    }
+};
+
+/// Sink for `animate.outputPath`
+///
+/// | outputPath                  | Output                                  |
+/// |-----------------------------|-----------------------------------------|
+/// | `out.y4m`, `-`              | Y4M to a file or stdout                 |
+/// | `out.rgba`, `rgba:-`        | Raw RGBA (`rgba:` forces it, as `y4m:`) |
+/// | `frame_%04d.ppm` / `.qoi`   | One image per frame                     |
+/// | `out.png`, `out.apng`       | Animated PNG                            |
+///
+/// Throws std::invalid_argument for other paths.
+inline std::unique_ptr<FrameSink> open_frame_sink(const CmdAnimate& animate,
+                                                  const OutputFactory& open = open_file_output) {
+    std::string path = animate.outputPath;
+    std::string format;
+    for (const char* prefix : {"y4m:", "rgba:"}) {
+        if (path.rfind(prefix, 0) == 0) {
+            format = std::string(prefix, std::char_traits<char>::length(prefix) - 1);
+            path.erase(0, format.size() + 1);
+        }
+    }
+    if (path.empty()) {
+        throw std::invalid_argument("CmdAnimate has no outputPath");
+    }
+    if (!(animate.frameRate > 0.0)) {
+        throw std::invalid_argument("CmdAnimate needs a positive frameRate");
+    }
+    bool stream = path == "-";
+    if (format.empty() && !stream) {
+        size_t dot = path.rfind('.');
+        if (dot != std::string::npos && path.find('/', dot) == std::string::npos) {
+            format = path.substr(dot + 1);
+            std::transform(format.begin(), format.end(), format.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        }
+    }
+    if (format.empty() && stream) {
+        format = "y4m";
+    }
+
+    if (!stream && path.find('%') != std::string::npos) {
+        if (format == "ppm" || format == "qoi") {
+            return std::make_unique<ImageSequenceSink>(
+                path, format == "qoi" ? ImageSequenceSink::Format::Qoi : ImageSequenceSink::Format::Ppm,
+                open);
+        }
+    } else if (format == "y4m") {
+        return std::make_unique<Y4mSink>(open(path), animate.frameRate);
+    } else if (format == "rgba" || format == "raw") {
+        return std::make_unique<RawRgbaSink>(open(path));
+    } else if ((format == "png" || format == "apng") && !stream) {
+        return std::make_unique<ApngSink>(open(path), animate.frameRate,
+                                          static_cast<uint32_t>(std::max(animate.totalFrames, 0)),
+                                          animate.loop);
+    }
+    throw std::invalid_argument("Unsupported animation output: " + animate.outputPath);
+}
+
+}  // namespace krayon::core
+
+#endif  // KRAYON_CORE_FRAME_SINK_HPP
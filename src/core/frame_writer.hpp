@@ -0,0 +1,131 @@
+#ifndef KRAYON_CORE_FRAME_WRITER_HPP
+#define KRAYON_CORE_FRAME_WRITER_HPP
+
+#include "frame_sink.hpp"
+#include "spsc_queue.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace krayon::core {
+
+/// Pipeline stage that encodes and writes frames on its own thread
+///
+/// Frame buffers are handed over by pointer: the renderer fills a buffer
+/// from acquire(), submit() moves it through an SPSC ring to the writer
+/// thread, which encodes straight from it and then returns it to a free
+/// list for the next acquire(). Conversion, compression and I/O therefore
+/// overlap with rendering, and no pixels are copied between stages.
+///
+///     FrameWriter writer(open_frame_sink(animate));
+///     AnimationExecutor<State, std::unique_ptr<FrameBuffer>> executor(pool);
+///     executor.run(animate, state_at,
+///         [&](const State& state, FrameTime time) {
+///             auto frame = writer.acquire(width, height);
+///             draw(state, time, *frame);
+///             return frame;
+///         },
+///         [&](FrameTime, std::unique_ptr<FrameBuffer> frame) {
+///             writer.submit(std::move(frame));
+///             return true;
+///         });
+///     writer.close();
+class FrameWriter {
+public:
+    /// `depth` frames may wait for the writer before submit() blocks
+    explicit FrameWriter(std::unique_ptr<FrameSink> sink, size_t depth = 4)
+        : sink(std::move(sink)), queue(depth), thread([this] { run(); }) {}
+
+    /// Finish the stream if close() was not called; errors are dropped
+    ~FrameWriter() {
+        if (thread.joinable()) {
+            queue.close();
+            thread.join();
+        }
+    }
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    /// A buffer of the given size, recycled when one is free (thread-safe)
+    std::unique_ptr<FrameBuffer> acquire(int width, int height) {
+        std::unique_ptr<FrameBuffer> frame;
+        {
+            std::lock_guard lock(free_mutex);
+            if (!free.empty()) {
+                frame = std::move(free.back());
+                free.pop_back();
+            }
+        }
+        if (!frame) {
+            frame = std::make_unique<FrameBuffer>();
+            allocated.fetch_add(1, std::memory_order_relaxed);
+        }
+        frame->resize(width, height);
+        return frame;
+    }
+
+    /// Queue the next frame, waiting while the writer is `depth` frames
+    /// behind. Only one thread may submit. Rethrows a failed write.
+    void submit(std::unique_ptr<FrameBuffer> frame) {
+        if (failed.load(std::memory_order_acquire) || !queue.push(std::move(frame))) {
+            rethrow();
+        }
+    }
+
+    /// Write the remaining frames and the trailer; rethrows a failed write
+    void close() {
+        queue.close();
+        thread.join();
+        rethrow();
+    }
+
+    /// Frames written so far
+    size_t frames_written() const { return written.load(std::memory_order_relaxed); }
+
+    /// Frame buffers created by acquire(); stays near the frames in flight
+    size_t buffers_allocated() const { return allocated.load(std::memory_order_relaxed); }
+
+private:
+    std::unique_ptr<FrameSink> sink;
+    SpscQueue<std::unique_ptr<FrameBuffer>> queue;
+    std::mutex free_mutex;
+    std::vector<std::unique_ptr<FrameBuffer>> free;
+    std::atomic<size_t> written{0};
+    std::atomic<size_t> allocated{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;  ///< Set by the writer thread before `failed`
+    std::thread thread;        ///< Last, so it starts after everything above
+
+    void run() {
+        try {
+            std::unique_ptr<FrameBuffer> frame;
+            while (queue.pop(frame)) {
+                sink->write(*frame);
+                written.fetch_add(1, std::memory_order_relaxed);
+                std::lock_guard lock(free_mutex);
+                free.push_back(std::move(frame));
+            }
+            sink->finish();
+        } catch (...) {
+            error = std::current_exception();
+            failed.store(true, std::memory_order_release);
+            queue.cancel();
+        }
+    }
+
+    void rethrow() {
+        if (failed.load(std::memory_order_acquire)) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+}  // namespace krayon::core
+
+#endif  // KRAYON_CORE_FRAME_WRITER_HPP
@@ -0,0 +1,133 @@
+#ifndef KRAYON_CORE_SPSC_QUEUE_HPP
+#define KRAYON_CORE_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace krayon::core {
+
+/// Bounded lock-free single-producer/single-consumer ring buffer
+///
+/// One thread may push and one other thread may pop. try_push/try_pop never
+/// block; push/pop block with atomic wait (back-pressure) when the ring is
+/// full or empty. The producer ends the stream with close(); the consumer
+/// can abandon it with cancel(). Both are flagged in the top bit of the
+/// index the caller owns, so a blocked peer is woken by the index change.
+template<typename T>
+class SpscQueue {
+public:
+    /// Capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const { return slots.size(); }
+
+    /// Producer: enqueue if there is room; value is moved only on success
+    bool try_push(T& value) {
+        uint64_t t = tail.load(std::memory_order_relaxed) & ~stop_bit;
+        if (t - cached_head == slots.size()) {
+            cached_head = head.load(std::memory_order_acquire) & ~stop_bit;
+            if (t - cached_head == slots.size()) {
+                return false;
+            }
+        }
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        tail.notify_one();
+        return true;
+    }
+
+    /// Producer: enqueue, waiting while the ring is full
+    /// @return false if the consumer cancelled
+    bool push(T value) {
+        while (!try_push(value)) {
+            uint64_t h = head.load(std::memory_order_acquire);
+            if (h & stop_bit) {
+                return false;
+            }
+            ++producer_waits;
+            head.wait(h, std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    /// Consumer: dequeue if anything is available
+    bool try_pop(T& value) {
+        uint64_t h = head.load(std::memory_order_relaxed) & ~stop_bit;
+        if (h == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire) & ~stop_bit;
+            if (h == cached_tail) {
+                return false;
+            }
+        }
+        value = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        head.notify_one();
+        return true;
+    }
+
+    /// Consumer: dequeue, waiting while the ring is empty
+    /// @return false once the producer closed and the ring is drained
+    bool pop(T& value) {
+        while (!try_pop(value)) {
+            uint64_t t = tail.load(std::memory_order_acquire);
+            if ((t & ~stop_bit) != (head.load(std::memory_order_relaxed) & ~stop_bit)) {
+                continue;
+            }
+            if (t & stop_bit) {
+                return false;
+            }
+            ++consumer_waits;
+            tail.wait(t, std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    /// Producer: no more items will be pushed
+    void close() {
+        tail.fetch_or(stop_bit, std::memory_order_release);
+        tail.notify_all();
+    }
+
+    /// Consumer: stop accepting items; a blocked producer returns false
+    void cancel() {
+        head.fetch_or(stop_bit, std::memory_order_release);
+        head.notify_all();
+    }
+
+    /// Times the producer had to wait for space (producer thread only)
+    size_t get_producer_waits() const { return producer_waits; }
+
+    /// Times the consumer had to wait for data (consumer thread only)
+    size_t get_consumer_waits() const { return consumer_waits; }
+
+private:
+    static constexpr size_t line = 64;  ///< Keeps head and tail on separate cache lines
+    static constexpr uint64_t stop_bit = uint64_t{1} << 63;
+
+    std::vector<T> slots;
+    size_t mask = 0;
+
+    alignas(line) std::atomic<uint64_t> head{0};
+    uint64_t cached_tail = 0;  ///< Consumer's view of tail
+    size_t consumer_waits = 0;
+
+    alignas(line) std::atomic<uint64_t> tail{0};
+    uint64_t cached_head = 0;  ///< Producer's view of head
+    size_t producer_waits = 0;
+};
+
+}  // namespace krayon::core
+
+#endif  // KRAYON_CORE_SPSC_QUEUE_HPP
@@ -0,0 +1,143 @@
+#ifndef KRAYON_CORE_WORK_STEALING_POOL_HPP
+#define KRAYON_CORE_WORK_STEALING_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace krayon::core {
+
+/// Thread pool with one task deque per worker
+///
+/// A task submitted from a worker goes to that worker's deque; other
+/// submissions are dealt round-robin. Workers run their own tasks oldest
+/// first and, when they run dry, steal the oldest task of another worker,
+/// so one long task does not hold up the tasks queued behind it. Each deque
+/// has its own lock, so workers only contend while stealing.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    /// Start the workers (at least one)
+    explicit WorkStealingPool(size_t threads = std::thread::hardware_concurrency()) {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; ++i) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    /// Run every queued task and join the workers
+    ~WorkStealingPool() {
+        {
+            std::lock_guard lock(sleep_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /// Queue a task; it runs on some worker thread
+    void submit(Task task) {
+        size_t index = current_pool == this
+                           ? current_index
+                           : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        // Counted before it is visible, so the count never drops below zero.
+        pending.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            // A worker checks pending under this lock before sleeping.
+            std::lock_guard lock(sleep_mutex);
+        }
+        wake.notify_one();
+    }
+
+    /// Number of worker threads
+    size_t size() const { return workers.size(); }
+
+    /// Tasks taken from another worker's deque so far
+    size_t steal_count() const { return steals.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next_queue{0};
+    std::atomic<size_t> pending{0};  ///< Queued, not yet started
+    std::atomic<size_t> steals{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    inline static thread_local const WorkStealingPool* current_pool = nullptr;
+    inline static thread_local size_t current_index = 0;
+
+    bool take(size_t index, Task& task) {
+        std::lock_guard lock(queues[index]->mutex);
+        if (queues[index]->tasks.empty()) {
+            return false;
+        }
+        task = std::move(queues[index]->tasks.front());
+        queues[index]->tasks.pop_front();
+        return true;
+    }
+
+    bool find_task(size_t self, Task& task) {
+        if (take(self, task)) {
+            return true;
+        }
+        for (size_t k = 1; k < queues.size(); ++k) {
+            if (take((self + k) % queues.size(), task)) {
+                steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(size_t self) {
+        current_pool = this;
+        current_index = self;
+        while (true) {
+            Task task;
+            if (find_task(self, task)) {
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                task();
+                continue;
+            }
+            std::unique_lock lock(sleep_mutex);
+            wake.wait(lock, [this] {
+                return stopping || pending.load(std::memory_order_acquire) > 0;
+            });
+            if (stopping && pending.load(std::memory_order_acquire) == 0) {
+                return;
+            }
+        }
+    }
+};
+
+}  // namespace krayon::core
+
+#endif  // KRAYON_CORE_WORK_STEALING_POOL_HPP
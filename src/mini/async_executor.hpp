@@ -0,0 +1,483 @@
+#pragma once
+
+#include "loop.hpp"
+#include "../core/thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+namespace krayon::mini {
+
+/**
+ * @file async_executor.hpp
+ * @brief Coroutine-based asynchronous command execution
+ *
+ * Long-running commands (hull builds, slicing) implement AsyncCommand and
+ * return a Task<CommandResult>. AsyncExecutor starts them on the calling
+ * thread and lets them move between two places:
+ *
+ * - the foreground: the thread that calls poll(), normally the UI thread;
+ *   the only place a command may touch its CommandContext
+ * - the background: a core::ThreadPool, for the heavy computation
+ *
+ * A command switches with `co_await scope.background()` and
+ * `co_await scope.foreground()`. `co_await scope.yield()` requeues it
+ * behind other work on the same side, so long commands interleave with
+ * short ones instead of holding a worker. Cancellation is checked at every
+ * such suspension point: a cancelled command is destroyed instead of
+ * resumed, and completes with "Cancelled".
+ *
+ * Commands that are not AsyncCommand run to completion inside submit(),
+ * so interactive commands never queue behind background work.
+ */
+
+/**
+ * @brief Lazily started coroutine producing a T
+ *
+ * Awaiting a Task starts it; the awaiting coroutine resumes when it
+ * finishes, on whichever thread it finished on. Exceptions propagate to
+ * the awaiter.
+ */
+template<typename T>
+class Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        auto final_suspend() noexcept {
+            struct ResumeAwaiter {
+                bool await_ready() noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<promise_type> handle) noexcept {
+                    std::coroutine_handle<> next = handle.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+            return ResumeAwaiter{};
+        }
+
+        template<typename U>
+        void return_value(U&& result) {
+            value.emplace(std::forward<U>(result));
+        }
+
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task() = default;
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+
+    ~Task() { reset(); }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        promise_type& promise = handle.promise();
+        if (promise.error) {
+            std::rethrow_exception(promise.error);
+        }
+        return std::move(*promise.value);
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    void reset() {
+        if (handle) {
+            handle.destroy();
+            handle = {};
+        }
+    }
+};
+
+class AsyncExecutor;
+class AsyncOperation;
+
+/**
+ * @brief Scheduling handle given to a running AsyncCommand
+ */
+class AsyncScope {
+public:
+    /**
+     * @brief Awaitable that continues the command on one side
+     */
+    struct Switch {
+        AsyncScope& scope;
+        bool background;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {}
+    };
+
+    /**
+     * @brief Continue on a pool thread
+     */
+    Switch background() { return {*this, true}; }
+
+    /**
+     * @brief Continue on the thread calling AsyncExecutor::poll()
+     */
+    Switch foreground() { return {*this, false}; }
+
+    /**
+     * @brief Let queued work on the current side run first
+     */
+    Switch yield() { return {*this, on_background}; }
+
+    /**
+     * @brief Has cancellation been requested?
+     *
+     * Suspension points check this already; loops that do not suspend
+     * should poll it.
+     */
+    bool cancelled() const;
+
+    bool in_background() const { return on_background; }
+
+private:
+    friend class AsyncOperation;
+
+    AsyncExecutor& executor;
+    AsyncOperation& operation;
+    bool on_background = false;
+
+    AsyncScope(AsyncExecutor& executor, AsyncOperation& operation)
+        : executor(executor), operation(operation) {}
+};
+
+/**
+ * @brief Interface for commands with a coroutine execute
+ *
+ * A command implementing both SceneCommand and AsyncCommand still runs
+ * synchronously through execute() everywhere except AsyncExecutor.
+ */
+class AsyncCommand {
+public:
+    virtual ~AsyncCommand() = default;
+
+    /**
+     * @brief Execute as a coroutine; starts on the foreground
+     *
+     * params stays valid until the task completes. context must only be
+     * used while on the foreground.
+     */
+    virtual Task<CommandResult> execute_async(const std::map<std::string, MiniValue>& params,
+                                              CommandContext& context, AsyncScope& scope) = 0;
+};
+
+/**
+ * @brief Shared state of one submitted command
+ */
+class AsyncOperation : public std::enable_shared_from_this<AsyncOperation> {
+public:
+    explicit AsyncOperation(AsyncExecutor& executor) : scope(executor, *this) {}
+
+    AsyncOperation(const AsyncOperation&) = delete;
+    AsyncOperation& operator=(const AsyncOperation&) = delete;
+
+    bool ready() const { return done.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Result of the command; only valid once ready()
+     */
+    const CommandResult& result() const { return outcome; }
+
+    /**
+     * @brief Block until the command completes
+     *
+     * Must not be called from the foreground thread while the command can
+     * still need it; poll ready() there instead.
+     */
+    const CommandResult& wait() const {
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [this] { return ready(); });
+        return outcome;
+    }
+
+    /**
+     * @brief Request cancellation; takes effect at the next suspension
+     */
+    void cancel() { cancel_flag.store(true, std::memory_order_relaxed); }
+
+    bool cancel_requested() const { return cancel_flag.load(std::memory_order_relaxed); }
+
+private:
+    friend class AsyncExecutor;
+    friend class AsyncScope;
+
+    std::map<std::string, MiniValue> params;
+    AsyncScope scope;
+    std::coroutine_handle<> root;  ///< Frame owning the command's task
+    CommandResult outcome;
+    std::atomic<bool> done{false};
+    std::atomic<bool> cancel_flag{false};
+    mutable std::mutex mutex;
+    mutable std::condition_variable finished;
+};
+
+/**
+ * @brief Runs AsyncCommands across the foreground thread and a thread pool
+ */
+class AsyncExecutor {
+public:
+    /**
+     * @param pool Must outlive the executor
+     */
+    explicit AsyncExecutor(core::ThreadPool& pool) : pool(pool) {}
+
+    /**
+     * @brief Cancel every pending command and wait for it to unwind
+     *
+     * Runs foreground continuations itself, so it must be called on the
+     * foreground thread.
+     */
+    ~AsyncExecutor() {
+        {
+            std::lock_guard lock(mutex);
+            for (AsyncOperation* operation : live) {
+                operation->cancel();
+            }
+        }
+        while (true) {
+            poll();
+            std::unique_lock lock(mutex);
+            if (live.empty()) {
+                break;
+            }
+            idle.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+
+    AsyncExecutor(const AsyncExecutor&) = delete;
+    AsyncExecutor& operator=(const AsyncExecutor&) = delete;
+
+    /**
+     * @brief Start a command on the calling (foreground) thread
+     *
+     * Synchronous commands complete before this returns; async ones run
+     * until their first suspension.
+     */
+    std::shared_ptr<AsyncOperation> submit(SceneCommand& command,
+                                           std::map<std::string, MiniValue> params,
+                                           CommandContext& context) {
+        auto operation = std::make_shared<AsyncOperation>(*this);
+        if (auto* async = dynamic_cast<AsyncCommand*>(&command)) {
+            operation->params = std::move(params);
+            start(operation, async->execute_async(operation->params, context, operation->scope));
+        } else {
+            complete(*operation, run_inline([&] { return command.execute(params, context); }),
+                     false);
+        }
+        return operation;
+    }
+
+    /**
+     * @brief Start a compiled command; loops run synchronously
+     */
+    std::shared_ptr<AsyncOperation> submit(const CompiledCommand& compiled,
+                                           CommandContext& context) {
+        auto* async = compiled.loop ? nullptr : dynamic_cast<AsyncCommand*>(compiled.command);
+        if (!async) {
+            auto operation = std::make_shared<AsyncOperation>(*this);
+            complete(*operation, run_inline([&] { return execute_compiled(compiled, context); }),
+                     false);
+            return operation;
+        }
+        BoundArguments bound = compiled.args;
+        if (compiled.program) {
+            CommandResult status = evaluate_arguments(compiled, bound, context);
+            if (!status.success) {
+                auto operation = std::make_shared<AsyncOperation>(*this);
+                complete(*operation, std::move(status), false);
+                return operation;
+            }
+        }
+        return submit(*compiled.command, compiled.schema->to_map(bound), context);
+    }
+
+    /**
+     * @brief Resume every command waiting for the foreground
+     * @return Number of continuations run
+     */
+    size_t poll() {
+        std::deque<Continuation> batch;
+        {
+            std::lock_guard lock(mutex);
+            batch.swap(foreground);
+        }
+        for (Continuation& continuation : batch) {
+            resume(*continuation.operation, continuation.handle);
+        }
+        return batch.size();
+    }
+
+    /**
+     * @brief Commands submitted and not yet complete
+     */
+    size_t pending() const {
+        std::lock_guard lock(mutex);
+        return live.size();
+    }
+
+private:
+    friend class AsyncScope;
+
+    struct Continuation {
+        std::shared_ptr<AsyncOperation> operation;
+        std::coroutine_handle<> handle;
+    };
+
+    /**
+     * @brief Root coroutine: owns the command's task and completes the operation
+     */
+    struct Driver {
+        struct promise_type {
+            Driver get_return_object() {
+                return {std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    core::ThreadPool& pool;
+    mutable std::mutex mutex;
+    std::condition_variable idle;
+    std::deque<Continuation> foreground;
+    std::unordered_set<AsyncOperation*> live;
+
+    template<typename Fn>
+    static CommandResult run_inline(Fn&& fn) {
+        try {
+            return fn();
+        } catch (const std::exception& e) {
+            return CommandResult(false, e.what());
+        } catch (...) {
+            return CommandResult(false, "Unknown error");
+        }
+    }
+
+    Driver drive(std::shared_ptr<AsyncOperation> operation, Task<CommandResult> task) {
+        CommandResult result;
+        try {
+            result = co_await task;
+        } catch (const std::exception& e) {
+            result = CommandResult(false, e.what());
+        } catch (...) {
+            result = CommandResult(false, "Unknown error");
+        }
+        complete(*operation, std::move(result), true);
+    }
+
+    void start(const std::shared_ptr<AsyncOperation>& operation, Task<CommandResult> task) {
+        {
+            std::lock_guard lock(mutex);
+            live.insert(operation.get());
+        }
+        operation->root = drive(operation, std::move(task)).handle;
+        operation->root.resume();
+    }
+
+    void schedule(AsyncOperation& operation, std::coroutine_handle<> handle, bool background) {
+        Continuation continuation{operation.shared_from_this(), handle};
+        if (background) {
+            pool.submit([this, continuation] {
+                resume(*continuation.operation, continuation.handle);
+            });
+        } else {
+            std::lock_guard lock(mutex);
+            foreground.push_back(std::move(continuation));
+        }
+    }
+
+    /**
+     * @brief Continue a suspended command, or destroy it if cancelled
+     *
+     * A command has at most one pending continuation, so nothing else can
+     * touch its frame here.
+     */
+    void resume(AsyncOperation& operation, std::coroutine_handle<> handle) {
+        if (operation.cancel_requested()) {
+            operation.root.destroy();
+            complete(operation, CommandResult(false, "Cancelled"), true);
+        } else {
+            handle.resume();
+        }
+    }
+
+    void complete(AsyncOperation& operation, CommandResult result, bool tracked) {
+        {
+            std::lock_guard lock(operation.mutex);
+            operation.outcome = std::move(result);
+            operation.done.store(true, std::memory_order_release);
+        }
+        operation.finished.notify_all();
+        if (tracked) {
+            // Notify under the lock: the destructor may be waiting to
+            // destroy idle as soon as live is empty.
+            std::lock_guard lock(mutex);
+            live.erase(&operation);
+            idle.notify_all();
+        }
+    }
+};
+
+inline void AsyncScope::Switch::await_suspend(std::coroutine_handle<> handle) {
+    // The coroutine may resume on another thread as soon as it is
+    // scheduled, so the scope is updated first.
+    scope.on_background = background;
+    scope.executor.schedule(scope.operation, handle, background);
+}
+
+inline bool AsyncScope::cancelled() const {
+    return operation.cancel_requested();
+}
+
+}  // namespace krayon::mini
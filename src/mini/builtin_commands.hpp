@@ -0,0 +1,372 @@
+#pragma once
+
+#include "command_schema.hpp"
+#include "element_store.hpp"
+#include "sealed_registry.hpp"
+#include "value.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file builtin_commands.hpp
+ * @brief Built-in scene commands
+ *
+ * The builtins operate on the context's ElementStore, the same store the
+ * bulk loop path, selectors and transactions write. Each implements
+ * SlotCommand, so compiled scripts call them with slot-bound arguments and
+ * no std::map is built per call; execute() serves name-keyed callers. Slot
+ * indexes follow the order of get_parameters().
+ */
+
+namespace builtin_commands {
+
+namespace detail {
+
+inline const MiniValue* find_param(const std::map<std::string, MiniValue>& params,
+                                   const char* name) {
+    auto it = params.find(name);
+    return it != params.end() ? &it->second : nullptr;
+}
+
+inline const std::string* text_of(const MiniValue* value) {
+    return value ? std::get_if<std::string>(value) : nullptr;
+}
+
+inline double number_of(const MiniValue* value) {
+    const double* number = value ? std::get_if<double>(value) : nullptr;
+    return number ? *number : 0.0;
+}
+
+/**
+ * @brief Any selector argument in a name-keyed call?
+ */
+inline bool has_selector(const std::map<std::string, MiniValue>& params) {
+    for (const char* name : {"select", "tag", "min_x", "min_y", "min_z", "max_x", "max_y",
+                             "max_z"}) {
+        if (params.contains(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline CommandResult missing(const char* name) {
+    return CommandResult(false, std::string("Missing required parameter: ") + name);
+}
+
+inline CommandResult no_store() {
+    return CommandResult(false, "Element commands need an element store");
+}
+
+inline CommandResult not_found(const std::string& id) {
+    return CommandResult(false, "Element not found: " + id);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Command to create a new scene element
+ */
+class CreateElementCommand : public SceneCommand, public SlotCommand {
+public:
+    std::string get_name() const override { return "create_element"; }
+
+    std::string get_description() const override {
+        return "Create a new scene element";
+    }
+
+    std::vector<Parameter> get_parameters() const override {
+        return {
+            {"type", "string", true, std::monostate(), "Element type"},
+            {"name", "string", true, std::monostate(), "Element name"},
+            {"x", "number", false, 0.0, "X coordinate"},
+            {"y", "number", false, 0.0, "Y coordinate"}
+        };
+    }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        return run(detail::find_param(params, "type"), detail::find_param(params, "name"),
+                   detail::find_param(params, "x"), detail::find_param(params, "y"), context);
+    }
+
+    CommandResult execute_slots(const BoundArguments& args, CommandContext& context) override {
+        return run(args.get(0), args.get(1), args.get(2), args.get(3), context);
+    }
+
+private:
+    static CommandResult run(const MiniValue* type, const MiniValue* name, const MiniValue* x,
+                             const MiniValue* y, CommandContext& context) {
+        const std::string* type_text = detail::text_of(type);
+        const std::string* id = detail::text_of(name);
+        if (!type_text || !id) {
+            return detail::missing(type_text ? "name" : "type");
+        }
+        const auto& store = context.get_element_store();
+        if (!store) {
+            return detail::no_store();
+        }
+        if (!store->create(*id, intern(*type_text), detail::number_of(x),
+                           detail::number_of(y))) {
+            return CommandResult(false, "Element already exists: " + *id);
+        }
+        return CommandResult(true);
+    }
+};
+
+/**
+ * @brief Command to delete a scene element
+ */
+class DeleteElementCommand : public SceneCommand, public SlotCommand {
+public:
+    std::string get_name() const override { return "delete_element"; }
+
+    std::string get_description() const override {
+        return "Delete a scene element";
+    }
+
+    std::vector<Parameter> get_parameters() const override {
+        return {
+            {"id", "string", true, std::monostate(), "Element ID"}
+        };
+    }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        return run(detail::find_param(params, "id"), context);
+    }
+
+    CommandResult execute_slots(const BoundArguments& args, CommandContext& context) override {
+        return run(args.get(0), context);
+    }
+
+private:
+    static CommandResult run(const MiniValue* id, CommandContext& context) {
+        const std::string* text = detail::text_of(id);
+        if (!text) {
+            return detail::missing("id");
+        }
+        const auto& store = context.get_element_store();
+        if (!store) {
+            return detail::no_store();
+        }
+        if (!store->remove(*text)) {
+            return detail::not_found(*text);
+        }
+        return CommandResult(true);
+    }
+};
+
+/**
+ * @brief Command to modify element properties
+ *
+ * Compiled scripts may pass a selector instead of id (see selector.hpp).
+ */
+class SetPropertyCommand : public SceneCommand, public SlotCommand {
+public:
+    std::string get_name() const override { return "set_property"; }
+
+    std::string get_description() const override {
+        return "Set a property of a scene element";
+    }
+
+    std::vector<Parameter> get_parameters() const override {
+        return {
+            {"id", "string", true, std::monostate(), "Element ID"},
+            {"property", "string", true, std::monostate(), "Property name"},
+            {"value", "any", true, std::monostate(), "Property value"},
+            {"select", "string", false, std::monostate(), "Id glob selecting many elements"},
+            {"tag", "any", false, std::monostate(), "Select elements with this tag property"},
+            {"min_x", "number", false, std::monostate(), "Selection box minimum X"},
+            {"min_y", "number", false, std::monostate(), "Selection box minimum Y"},
+            {"min_z", "number", false, std::monostate(), "Selection box minimum Z"},
+            {"max_x", "number", false, std::monostate(), "Selection box maximum X"},
+            {"max_y", "number", false, std::monostate(), "Selection box maximum Y"},
+            {"max_z", "number", false, std::monostate(), "Selection box maximum Z"}
+        };
+    }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        if (detail::has_selector(params)) {
+            return CommandResult(false, "Selectors only run through compiled scripts");
+        }
+        return run(detail::find_param(params, "id"), detail::find_param(params, "property"),
+                   detail::find_param(params, "value"), context);
+    }
+
+    CommandResult execute_slots(const BoundArguments& args, CommandContext& context) override {
+        return run(args.get(0), args.get(1), args.get(2), context);
+    }
+
+private:
+    static CommandResult run(const MiniValue* id, const MiniValue* property,
+                             const MiniValue* value, CommandContext& context) {
+        const std::string* text = detail::text_of(id);
+        const std::string* name = detail::text_of(property);
+        if (!text || !name || !value) {
+            return detail::missing(!text ? "id" : !name ? "property" : "value");
+        }
+        const auto& store = context.get_element_store();
+        if (!store) {
+            return detail::no_store();
+        }
+        ElementStore::Row row = store->find(*text);
+        if (row == ElementStore::npos) {
+            return detail::not_found(*text);
+        }
+        store->set_property(row, intern(*name), Value::from_mini(*value));
+        return CommandResult(true);
+    }
+};
+
+/**
+ * @brief Command to query element properties
+ *
+ * The property's value is the result's return value; null if never set.
+ */
+class GetPropertyCommand : public SceneCommand, public SlotCommand {
+public:
+    std::string get_name() const override { return "get_property"; }
+
+    std::string get_description() const override {
+        return "Get a property of a scene element";
+    }
+
+    std::vector<Parameter> get_parameters() const override {
+        return {
+            {"id", "string", true, std::monostate(), "Element ID"},
+            {"property", "string", true, std::monostate(), "Property name"}
+        };
+    }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        return run(detail::find_param(params, "id"), detail::find_param(params, "property"),
+                   context);
+    }
+
+    CommandResult execute_slots(const BoundArguments& args, CommandContext& context) override {
+        return run(args.get(0), args.get(1), context);
+    }
+
+private:
+    static CommandResult run(const MiniValue* id, const MiniValue* property,
+                             CommandContext& context) {
+        const std::string* text = detail::text_of(id);
+        const std::string* name = detail::text_of(property);
+        if (!text || !name) {
+            return detail::missing(text ? "property" : "id");
+        }
+        const auto& store = context.get_element_store();
+        if (!store) {
+            return detail::no_store();
+        }
+        ElementStore::Row row = store->find(*text);
+        if (row == ElementStore::npos) {
+            return detail::not_found(*text);
+        }
+        // A property name nobody has interned was never set.
+        auto symbol = SymbolTable::global().find(*name);
+        Value value = symbol ? store->get_property(row, *symbol) : Value();
+        return CommandResult(true, "", value.to_mini());
+    }
+};
+
+/**
+ * @brief Command to apply a transformation
+ *
+ * The element store keeps positions only, so `move` is the one operation
+ * it supports. Compiled scripts may pass a selector instead of id (see
+ * selector.hpp).
+ */
+class TransformCommand : public SceneCommand, public SlotCommand {
+public:
+    std::string get_name() const override { return "transform"; }
+
+    std::string get_description() const override {
+        return "Apply transformation to an element";
+    }
+
+    std::vector<Parameter> get_parameters() const override {
+        return {
+            {"id", "string", true, std::monostate(), "Element ID"},
+            {"operation", "string", true, std::monostate(), "Transform operation (move, rotate, scale)"},
+            {"x", "number", false, 0.0, "X parameter"},
+            {"y", "number", false, 0.0, "Y parameter"},
+            {"z", "number", false, 0.0, "Z parameter"},
+            {"select", "string", false, std::monostate(), "Id glob selecting many elements"},
+            {"tag", "any", false, std::monostate(), "Select elements with this tag property"},
+            {"min_x", "number", false, std::monostate(), "Selection box minimum X"},
+            {"min_y", "number", false, std::monostate(), "Selection box minimum Y"},
+            {"min_z", "number", false, std::monostate(), "Selection box minimum Z"},
+            {"max_x", "number", false, std::monostate(), "Selection box maximum X"},
+            {"max_y", "number", false, std::monostate(), "Selection box maximum Y"},
+            {"max_z", "number", false, std::monostate(), "Selection box maximum Z"}
+        };
+    }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        if (detail::has_selector(params)) {
+            return CommandResult(false, "Selectors only run through compiled scripts");
+        }
+        return run(detail::find_param(params, "id"), detail::find_param(params, "operation"),
+                   detail::find_param(params, "x"), detail::find_param(params, "y"),
+                   detail::find_param(params, "z"), context);
+    }
+
+    CommandResult execute_slots(const BoundArguments& args, CommandContext& context) override {
+        return run(args.get(0), args.get(1), args.get(2), args.get(3), args.get(4), context);
+    }
+
+private:
+    static CommandResult run(const MiniValue* id, const MiniValue* operation, const MiniValue* x,
+                             const MiniValue* y, const MiniValue* z, CommandContext& context) {
+        const std::string* text = detail::text_of(id);
+        const std::string* op = detail::text_of(operation);
+        if (!text || !op) {
+            return detail::missing(text ? "operation" : "id");
+        }
+        if (*op != "move") {
+            return CommandResult(false, "Unsupported transform operation: " + *op);
+        }
+        const auto& store = context.get_element_store();
+        if (!store) {
+            return detail::no_store();
+        }
+        ElementStore::Row row = store->find(*text);
+        if (row == ElementStore::npos) {
+            return detail::not_found(*text);
+        }
+        store->translate(row, detail::number_of(x), detail::number_of(y), detail::number_of(z));
+        return CommandResult(true);
+    }
+};
+
+/**
+ * @brief Index in builtin_command_names of the builtin a command is, or -1
+ *
+ * Matches the dynamic type rather than the name, so a command registered
+ * under a builtin's name keeps its own behaviour wherever the builtins
+ * take a columnar or buffered shortcut.
+ */
+inline int builtin_index_of(const SceneCommand& command) {
+    const std::type_info& type = typeid(command);
+    if (type == typeid(CreateElementCommand)) return builtin_command_index("create_element");
+    if (type == typeid(DeleteElementCommand)) return builtin_command_index("delete_element");
+    if (type == typeid(SetPropertyCommand)) return builtin_command_index("set_property");
+    if (type == typeid(GetPropertyCommand)) return builtin_command_index("get_property");
+    if (type == typeid(TransformCommand)) return builtin_command_index("transform");
+    return -1;
+}
+
+}  // namespace builtin_commands
+
+}  // namespace krayon::mini
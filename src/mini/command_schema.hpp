@@ -0,0 +1,250 @@
+#pragma once
+
+#include "mini_lang.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file command_schema.hpp
+ * @brief Precomputed parameter schemas and slot-indexed argument binding
+ *
+ * A CommandSchema is built once per command from get_parameters(). Each
+ * parameter gets a fixed slot; the script compiler writes argument values
+ * straight into a BoundArguments array, applying defaults and validation
+ * once when the script is compiled instead of on every execution.
+ */
+
+/**
+ * @brief Maximum number of parameters a command can declare
+ */
+constexpr size_t max_parameter_slots = 16;
+
+/**
+ * @brief Value kinds accepted by a parameter slot
+ */
+enum class ValueKind : uint8_t {
+    Any,
+    Number,
+    String,
+    Bool
+};
+
+/**
+ * @brief Map a Parameter::type string to a ValueKind
+ */
+inline ValueKind parse_value_kind(const std::string& type) {
+    if (type == "number") return ValueKind::Number;
+    if (type == "string") return ValueKind::String;
+    if (type == "bool") return ValueKind::Bool;
+    return ValueKind::Any;
+}
+
+/**
+ * @brief Check a value against a slot kind (null never matches a typed slot)
+ */
+inline bool value_matches_kind(const MiniValue& value, ValueKind kind) {
+    switch (kind) {
+        case ValueKind::Number: return std::holds_alternative<double>(value);
+        case ValueKind::String: return std::holds_alternative<std::string>(value);
+        case ValueKind::Bool: return std::holds_alternative<bool>(value);
+        case ValueKind::Any: return true;
+    }
+    return false;
+}
+
+/**
+ * @brief One parameter of a command schema
+ */
+struct ParameterSlot {
+    SymbolId name = invalid_symbol;
+    ValueKind kind = ValueKind::Any;
+    bool required = true;
+    MiniValue default_value;
+};
+
+/**
+ * @brief Argument values stored by slot index
+ */
+struct BoundArguments {
+    std::array<MiniValue, max_parameter_slots> values;
+    uint32_t present = 0;  ///< Bit i set when slot i holds a value
+
+    bool has(size_t slot) const { return (present >> slot) & 1u; }
+
+    /**
+     * @brief Value in a slot, or nullptr if unset
+     */
+    const MiniValue* get(size_t slot) const {
+        return has(slot) ? &values[slot] : nullptr;
+    }
+
+    void set(size_t slot, MiniValue value) {
+        values[slot] = std::move(value);
+        present |= uint32_t{1} << slot;
+    }
+};
+
+/**
+ * @brief Slot layout for one command's parameters
+ */
+class CommandSchema {
+public:
+    /**
+     * @brief Lay out a command's parameters
+     *
+     * A command with more than max_parameter_slots parameters gets an
+     * empty schema whose status() reports the problem.
+     */
+    explicit CommandSchema(const SceneCommand& command) {
+        std::vector<Parameter> params = command.get_parameters();
+        if (params.size() > max_parameter_slots) {
+            status_result = CommandResult(
+                false, command.get_name() + " declares " + std::to_string(params.size()) +
+                           " parameters; at most " + std::to_string(max_parameter_slots) +
+                           " are supported");
+            return;
+        }
+        for (const Parameter& param : params) {
+            slots.push_back({intern(param.name), parse_value_kind(param.type),
+                             param.required, param.default_value});
+        }
+    }
+
+    /**
+     * @brief Failed result if the command does not fit a schema
+     */
+    const CommandResult& status() const { return status_result; }
+
+    /**
+     * @brief Slot index for a parameter name, or -1
+     */
+    int slot_of(SymbolId name) const {
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (slots[i].name == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    const std::vector<ParameterSlot>& get_slots() const { return slots; }
+
+    /**
+     * @brief Fill defaults and check required parameters and types
+     * @param deferred Slots filled at execution time; they count as
+     * present and are type-checked by check_kinds() once bound
+     * @return Failed result describing the first problem, or success
+     */
+    CommandResult finalize(BoundArguments& args, uint32_t deferred = 0) const {
+        for (size_t i = 0; i < slots.size(); ++i) {
+            const ParameterSlot& slot = slots[i];
+            if ((deferred >> i) & 1u) {
+                continue;
+            }
+            if (!args.has(i)) {
+                if (slot.required) {
+                    return CommandResult(false, "Missing required parameter: " +
+                                                    std::string(name_of(i)));
+                }
+                if (!std::holds_alternative<std::monostate>(slot.default_value)) {
+                    args.set(i, slot.default_value);
+                }
+                continue;
+            }
+            if (!value_matches_kind(args.values[i], slot.kind)) {
+                return CommandResult(false, "Type mismatch for parameter: " +
+                                                std::string(name_of(i)));
+            }
+        }
+        return CommandResult(true);
+    }
+
+    /**
+     * @brief Type-check the given slots
+     */
+    CommandResult check_kinds(const BoundArguments& args, uint32_t mask) const {
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (((mask >> i) & 1u) && !value_matches_kind(args.values[i], slots[i].kind)) {
+                return CommandResult(false, "Type mismatch for parameter: " +
+                                                std::string(name_of(i)));
+            }
+        }
+        return CommandResult(true);
+    }
+
+    /**
+     * @brief Convert bound arguments back to the name-keyed form
+     */
+    std::map<std::string, MiniValue> to_map(const BoundArguments& args) const {
+        std::map<std::string, MiniValue> params;
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (args.has(i)) {
+                params.emplace(name_of(i), args.values[i]);
+            }
+        }
+        return params;
+    }
+
+    std::string_view name_of(size_t slot) const {
+        return SymbolTable::global().name(slots[slot].name);
+    }
+
+private:
+    std::vector<ParameterSlot> slots;
+    CommandResult status_result;
+};
+
+/**
+ * @brief Optional interface for commands that read arguments by slot
+ *
+ * Commands implementing it alongside SceneCommand skip the conversion of
+ * bound arguments back into a std::map on every call. Their compile-time
+ * validation goes through validate_slots() instead of validate_parameters().
+ */
+class SlotCommand {
+public:
+    virtual ~SlotCommand() = default;
+
+    virtual CommandResult execute_slots(const BoundArguments& args,
+                                        CommandContext& context) = 0;
+
+    /**
+     * @brief Command-specific checks beyond the schema's required/type rules
+     */
+    virtual CommandResult validate_slots(const BoundArguments& args) const {
+        (void)args;
+        return CommandResult(true);
+    }
+};
+
+struct CompiledLoop;
+class ExprProgram;
+
+/**
+ * @brief A command with validated, slot-bound arguments ready to run
+ *
+ * Arguments that depend on context variables are computed by program at
+ * execution time and validated then. A compiled `for` loop has no
+ * command of its own; loop is set instead.
+ */
+struct CompiledCommand {
+    SceneCommand* command = nullptr;
+    SlotCommand* slot_command = nullptr;  ///< Set when command implements SlotCommand
+    const CommandSchema* schema = nullptr;
+    BoundArguments args;
+    size_t source_offset = 0;
+    std::shared_ptr<const ExprProgram> program;
+    std::shared_ptr<const CompiledLoop> loop;
+    uint32_t selector_slots = 0;  ///< Selector arguments given; runs execute_selection()
+
+    bool empty() const { return !command && !loop; }
+};
+
+}  // namespace krayon::mini
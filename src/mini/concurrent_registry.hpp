@@ -0,0 +1,327 @@
+#pragma once
+
+#include "sealed_registry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file concurrent_registry.hpp
+ * @brief Read-mostly command registry shared by concurrent sessions
+ *
+ * ConcurrentCommandRegistry publishes immutable SealedCommandRegistry
+ * versions through an atomic pointer (read-copy-update). Registering a
+ * command copies the current version, changes the copy and installs it
+ * with a compare-and-swap, so writers never block readers or each other.
+ *
+ * Each session owns a Reader. A Reader's pin() stamps the current epoch
+ * into the reader's own slot and loads the current version: a fixed number
+ * of atomic operations with no locks, retries or shared reference counts,
+ * so lookups are wait-free. A replaced version is retired with the epoch
+ * of its replacement and freed once every slot stamped at or before that
+ * epoch has been released.
+ */
+
+/**
+ * @brief Registry that can be read and extended from many threads at once
+ */
+class ConcurrentCommandRegistry {
+    struct Version;
+    struct ReaderSlot;
+
+public:
+    class Reader;
+
+    /**
+     * @brief Read-side critical section; the version it shows stays alive
+     * until the pin is destroyed
+     */
+    class Pin {
+    public:
+        ~Pin() { reader.unpin(); }
+
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+
+        const SealedCommandRegistry& registry() const { return *version->table; }
+        const SealedCommandRegistry* operator->() const { return version->table.get(); }
+
+        SceneCommand* find(std::string_view name) const noexcept {
+            return version->table->find(name);
+        }
+
+        SceneCommand* find(SymbolId name) const noexcept { return version->table->find(name); }
+
+        /**
+         * @brief Keep this version alive beyond the pin, e.g. for scripts
+         * compiled against it
+         */
+        std::shared_ptr<const SealedCommandRegistry> share() const { return version->table; }
+
+        /**
+         * @brief Number of registry changes before this version
+         */
+        uint64_t version_number() const { return version->number; }
+
+    private:
+        friend class Reader;
+        friend class ConcurrentCommandRegistry;
+
+        Reader& reader;
+        Version* version;
+
+        explicit Pin(Reader& reader) : reader(reader), version(reader.pin_version()) {}
+    };
+
+    /**
+     * @brief Per-session read handle; use from one thread at a time
+     */
+    class Reader {
+    public:
+        explicit Reader(ConcurrentCommandRegistry& registry)
+            : registry(registry), slot(registry.acquire_slot()) {}
+
+        ~Reader() { slot->in_use.store(false, std::memory_order_release); }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        /**
+         * @brief Enter a read section; pins may nest
+         */
+        Pin pin() { return Pin(*this); }
+
+    private:
+        friend class Pin;
+
+        ConcurrentCommandRegistry& registry;
+        ReaderSlot* slot;
+        Version* pinned = nullptr;
+        uint32_t depth = 0;
+
+        Version* pin_version() {
+            if (depth++ == 0) {
+                slot->epoch.store(registry.epoch.load(std::memory_order_seq_cst),
+                                  std::memory_order_seq_cst);
+                pinned = registry.current.load(std::memory_order_seq_cst);
+            }
+            return pinned;
+        }
+
+        void unpin() {
+            if (--depth == 0) {
+                slot->epoch.store(0, std::memory_order_release);
+            }
+        }
+    };
+
+    ConcurrentCommandRegistry() : current(new Version()) {
+        current.load()->table = std::make_shared<SealedCommandRegistry>();
+    }
+
+    /**
+     * @brief Start from the commands in a registry
+     */
+    explicit ConcurrentCommandRegistry(const CommandRegistry& registry)
+        : ConcurrentCommandRegistry() {
+        Version* first = current.load();
+        for (const std::string& name : registry.get_all_commands()) {
+            first->commands.push_back(registry.get_command(name));
+        }
+        first->table = build_table(first->commands);
+    }
+
+    /**
+     * @brief Free every version; no Reader may outlive the registry
+     */
+    ~ConcurrentCommandRegistry() {
+        delete current.load();
+        Version* retired = retired_head.load();
+        while (retired) {
+            delete std::exchange(retired, retired->next_retired);
+        }
+        ReaderSlot* slot = slots_head.load();
+        while (slot) {
+            delete std::exchange(slot, slot->next);
+        }
+    }
+
+    ConcurrentCommandRegistry(const ConcurrentCommandRegistry&) = delete;
+    ConcurrentCommandRegistry& operator=(const ConcurrentCommandRegistry&) = delete;
+
+    /**
+     * @brief Add or replace a command; visible to pins taken afterwards
+     */
+    void register_command(std::shared_ptr<SceneCommand> command) {
+        std::string name = command->get_name();
+        update([&](std::vector<std::shared_ptr<SceneCommand>>& commands) {
+            for (auto& existing : commands) {
+                if (existing->get_name() == name) {
+                    existing = command;
+                    return true;
+                }
+            }
+            commands.push_back(command);
+            return true;
+        });
+    }
+
+    /**
+     * @brief Remove a command
+     * @return false if it was not registered
+     */
+    bool unregister_command(std::string_view name) {
+        return update([&](std::vector<std::shared_ptr<SceneCommand>>& commands) {
+            for (size_t i = 0; i < commands.size(); ++i) {
+                if (commands[i]->get_name() == name) {
+                    commands.erase(commands.begin() + static_cast<std::ptrdiff_t>(i));
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    /**
+     * @brief The current version, kept alive by the returned pointer
+     */
+    std::shared_ptr<const SealedCommandRegistry> snapshot() {
+        Reader reader(*this);
+        return reader.pin().share();
+    }
+
+    /**
+     * @brief Free retired versions no reader can still see
+     * @return Versions still waiting for readers
+     */
+    size_t collect() {
+        if (collecting.exchange(true, std::memory_order_acquire)) {
+            return 0;
+        }
+        // Take the list before scanning, so every version in it was
+        // retired before any stamp is read.
+        Version* retired = retired_head.exchange(nullptr, std::memory_order_seq_cst);
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (ReaderSlot* slot = slots_head.load(std::memory_order_acquire); slot;
+             slot = slot->next) {
+            uint64_t stamp = slot->epoch.load(std::memory_order_seq_cst);
+            if (stamp != 0 && stamp < oldest) {
+                oldest = stamp;
+            }
+        }
+        size_t waiting = 0;
+        while (retired) {
+            Version* next = retired->next_retired;
+            if (retired->retired_at < oldest) {
+                delete retired;
+            } else {
+                push_retired(retired);
+                ++waiting;
+            }
+            retired = next;
+        }
+        collecting.store(false, std::memory_order_release);
+        return waiting;
+    }
+
+private:
+    struct Version {
+        std::shared_ptr<const SealedCommandRegistry> table;
+        std::vector<std::shared_ptr<SceneCommand>> commands;
+        uint64_t number = 0;
+        uint64_t retired_at = 0;
+        Version* next_retired = nullptr;
+    };
+
+    struct ReaderSlot {
+        std::atomic<uint64_t> epoch{0};  ///< 0 when not reading
+        std::atomic<bool> in_use{true};
+        ReaderSlot* next = nullptr;
+    };
+
+    std::atomic<Version*> current;
+    std::atomic<uint64_t> epoch{1};
+    std::atomic<Version*> retired_head{nullptr};
+    std::atomic<ReaderSlot*> slots_head{nullptr};
+    std::atomic<bool> collecting{false};
+
+    static std::shared_ptr<const SealedCommandRegistry> build_table(
+        const std::vector<std::shared_ptr<SceneCommand>>& commands) {
+        CommandRegistry registry;
+        for (const auto& command : commands) {
+            registry.register_command(command);
+        }
+        return std::make_shared<SealedCommandRegistry>(registry);
+    }
+
+    /**
+     * @brief Copy-on-write update; retried if another writer got in first
+     */
+    template<typename EditFn>
+    bool update(EditFn&& edit) {
+        Reader reader(*this);
+        Version* replaced = nullptr;
+        while (!replaced) {
+            Pin pin = reader.pin();
+            Version* base = pin.version;
+            auto next = std::make_unique<Version>();
+            next->commands = base->commands;
+            if (!edit(next->commands)) {
+                return false;
+            }
+            next->table = build_table(next->commands);
+            next->number = base->number + 1;
+            if (current.compare_exchange_strong(base, next.get(), std::memory_order_seq_cst)) {
+                next.release();
+                replaced = base;
+            }
+        }
+        // Readers stamped at or before this epoch may still hold the old
+        // version; later ones load the new pointer.
+        replaced->retired_at = epoch.fetch_add(1, std::memory_order_seq_cst);
+        push_retired(replaced);
+        collect();
+        return true;
+    }
+
+    void push_retired(Version* version) {
+        Version* head = retired_head.load(std::memory_order_relaxed);
+        do {
+            version->next_retired = head;
+        } while (!retired_head.compare_exchange_weak(head, version, std::memory_order_release,
+                                                     std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief Reuse a released slot or add one; slots live as long as the
+     * registry
+     */
+    ReaderSlot* acquire_slot() {
+        for (ReaderSlot* slot = slots_head.load(std::memory_order_acquire); slot;
+             slot = slot->next) {
+            bool free = false;
+            if (!slot->in_use.load(std::memory_order_relaxed) &&
+                slot->in_use.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+                return slot;
+            }
+        }
+        auto* slot = new ReaderSlot();
+        ReaderSlot* head = slots_head.load(std::memory_order_relaxed);
+        do {
+            slot->next = head;
+        } while (!slots_head.compare_exchange_weak(head, slot, std::memory_order_release,
+                                                   std::memory_order_relaxed));
+        return slot;
+    }
+};
+
+}  // namespace krayon::mini
@@ -0,0 +1,518 @@
+#pragma once
+
+#include "symbol_table.hpp"
+#include "value.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory_resource>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file element_store.hpp
+ * @brief Columnar storage for scene elements
+ *
+ * Elements are stored structure-of-arrays: one column each for id, type
+ * and position, plus one lazily created column per property. Rows are
+ * dense; removing an element moves the last row into its place. Columns
+ * are exposed whole so loops over many elements run as tight per-column
+ * passes instead of per-element command dispatch.
+ *
+ * Element ids are kept in a table owned by the store rather than the
+ * global SymbolTable, so ids generated by loops are freed with their
+ * elements: a removed element's name slot is reused by the next create().
+ *
+ * A sorted index of id names, built on first use and rebuilt after rows
+ * are added or removed, answers id prefix queries.
+ *
+ * Properties may also carry secondary indexes: a hash index from value to
+ * rows for equality queries and a sorted index of numeric values for range
+ * queries. Both are kept up to date by set_property(), create() and
+ * remove(); writes through property_column() bypass them, so callers must
+ * use set_property() for indexed properties.
+ *
+ * translate() and set_property() on an unindexed property whose column is
+ * already sized (see property_column()) only touch their own row, so
+ * writes to different rows may run concurrently, as long as nothing
+ * creates or removes elements meanwhile.
+ */
+
+/**
+ * @brief Structure-of-arrays element table keyed by id
+ */
+class ElementStore {
+public:
+    using Row = uint32_t;
+
+    static constexpr Row npos = std::numeric_limits<Row>::max();
+
+    /**
+     * @brief Entry of the id name index
+     */
+    struct NamedRow {
+        std::string_view name;
+        Row row;
+    };
+
+    /**
+     * @brief Kinds of secondary property index
+     */
+    enum class IndexKind : uint8_t {
+        Hash = 1,    ///< Equality on any value
+        Sorted = 2   ///< Ranges over numeric values
+    };
+
+    size_t size() const { return ids.size(); }
+    bool empty() const { return ids.empty(); }
+
+    void reserve(size_t count) {
+        ids.reserve(count);
+        rows.reserve(count);
+        types.reserve(count);
+        x.reserve(count);
+        y.reserve(count);
+        z.reserve(count);
+    }
+
+    /**
+     * @brief Row of an element, or npos
+     */
+    Row find(std::string_view id) const {
+        auto it = rows.find(id);
+        return it != rows.end() ? it->second : npos;
+    }
+
+    bool contains(std::string_view id) const { return rows.contains(id); }
+
+    /**
+     * @brief Add an element
+     * @return false if the id is already taken
+     */
+    bool create(std::string_view id, SymbolId type, double px = 0.0, double py = 0.0,
+                double pz = 0.0) {
+        if (rows.contains(id)) {
+            return false;
+        }
+        uint32_t slot;
+        if (free_names.empty()) {
+            slot = static_cast<uint32_t>(names.size());
+            names.emplace_back(id);
+        } else {
+            slot = free_names.back();
+            free_names.pop_back();
+            names[slot].assign(id);
+        }
+        rows.emplace(names[slot], static_cast<Row>(ids.size()));
+        ++structure;
+        ids.push_back(slot);
+        types.push_back(type);
+        x.push_back(px);
+        y.push_back(py);
+        z.push_back(pz);
+        return true;
+    }
+
+    /**
+     * @brief Remove an element, moving the last row into its place
+     * @return false if there is no such element
+     */
+    bool remove(std::string_view id) {
+        auto found = rows.find(id);
+        if (found == rows.end()) {
+            return false;
+        }
+        Row row = found->second;
+        Row last = static_cast<Row>(ids.size() - 1);
+        uint32_t slot = ids[row];
+        rows.erase(found);
+        names[slot].clear();
+        free_names.push_back(slot);
+        ++structure;
+        if (row != last) {
+            ids[row] = ids[last];
+            types[row] = types[last];
+            x[row] = x[last];
+            y[row] = y[last];
+            z[row] = z[last];
+            rows.find(names[ids[row]])->second = row;
+        }
+        ids.pop_back();
+        types.pop_back();
+        x.pop_back();
+        y.pop_back();
+        z.pop_back();
+        // Property columns may be shorter than the table; a missing entry
+        // is null.
+        properties.for_each([&](SymbolId property, std::vector<Value>& column) {
+            if (PropertyIndex* index = indexes.find(property)) {
+                if (column.size() > row) {
+                    index->erase(row, column[row]);
+                }
+                if (row != last && column.size() > last) {
+                    index->move(last, row, column[last]);
+                }
+            }
+            if (column.size() > last) {
+                column[row] = column[last];
+                column.pop_back();
+            } else if (column.size() > row) {
+                column[row] = Value();
+            }
+        });
+        return true;
+    }
+
+    void clear() {
+        ids.clear();
+        types.clear();
+        x.clear();
+        y.clear();
+        z.clear();
+        properties.clear();
+        rows.clear();
+        names.clear();
+        free_names.clear();
+        indexes.for_each([](SymbolId, PropertyIndex& index) { index.reset(); });
+        ++structure;
+    }
+
+    /**
+     * @brief Changes whenever rows are added or removed
+     */
+    uint64_t structure_version() const { return structure; }
+
+    /**
+     * @brief Elements whose id starts with prefix, sorted by id
+     *
+     * Valid until the next create(), remove() or clear().
+     */
+    std::span<const NamedRow> rows_with_id_prefix(std::string_view prefix) const {
+        if (name_index_version != structure) {
+            name_index.clear();
+            name_index.reserve(ids.size());
+            for (Row row = 0; row < ids.size(); ++row) {
+                name_index.push_back({names[ids[row]], row});
+            }
+            std::sort(name_index.begin(), name_index.end(),
+                      [](const NamedRow& a, const NamedRow& b) { return a.name < b.name; });
+            name_index_version = structure;
+        }
+        auto first = std::lower_bound(
+            name_index.begin(), name_index.end(), prefix,
+            [](const NamedRow& entry, std::string_view key) { return entry.name < key; });
+        auto last = first;
+        while (last != name_index.end() && last->name.starts_with(prefix)) {
+            ++last;
+        }
+        return {first, last};
+    }
+
+    /**
+     * @brief Property of the element at row; null if never set
+     */
+    Value get_property(Row row, SymbolId property) const {
+        const std::vector<Value>* column = properties.find(property);
+        if (!column || row >= column->size()) {
+            return Value();
+        }
+        return (*column)[row];
+    }
+
+    void set_property(Row row, SymbolId property, Value value) {
+        Value& slot = property_column(property)[row];
+        if (PropertyIndex* index = indexes.find(property); index && slot != value) {
+            index->erase(row, slot);
+            index->insert(row, value);
+        }
+        slot = value;
+    }
+
+    /**
+     * @brief Entry of a batched property write
+     */
+    struct RowValue {
+        Row row;
+        Value value;
+    };
+
+    /**
+     * @brief Write many rows of one property, updating its indexes once
+     *
+     * A later write to the same row wins. When the batch covers a large
+     * share of the column, indexes are rebuilt after the column pass
+     * instead of being updated row by row.
+     */
+    void set_properties(SymbolId property, std::span<const RowValue> writes) {
+        std::vector<Value>& column = property_column(property);
+        PropertyIndex* index = indexes.find(property);
+        if (index && writes.size() * 4 < column.size()) {
+            for (const RowValue& write : writes) {
+                if (column[write.row] != write.value) {
+                    index->erase(write.row, column[write.row]);
+                    index->insert(write.row, write.value);
+                    column[write.row] = write.value;
+                }
+            }
+            return;
+        }
+        for (const RowValue& write : writes) {
+            column[write.row] = write.value;
+        }
+        if (index) {
+            index->rebuild(column);
+        }
+    }
+
+    /**
+     * @brief Column for a property, sized to the current element count
+     *
+     * Columns grow lazily, so rows added after the last call may be
+     * missing until the column is requested again. Writes through the
+     * column do not update indexes (see is_indexed()).
+     */
+    std::vector<Value>& property_column(SymbolId property) {
+        std::vector<Value>* column = properties.find(property);
+        if (!column) {
+            column = &properties.insert_or_assign(property, std::vector<Value>());
+        }
+        if (column->size() < ids.size()) {
+            column->resize(ids.size());
+        }
+        return *column;
+    }
+
+    /**
+     * @brief Index a property; a no-op if that index already exists
+     */
+    void create_index(SymbolId property, IndexKind kind) {
+        PropertyIndex* index = indexes.find(property);
+        if (!index) {
+            index = &indexes.insert_or_assign(property, PropertyIndex());
+        }
+        uint8_t bit = static_cast<uint8_t>(kind);
+        if (index->kinds & bit) {
+            return;
+        }
+        index->kinds |= bit;
+        index->rebuild(property_column(property));
+    }
+
+    void drop_index(SymbolId property, IndexKind kind) {
+        PropertyIndex* index = indexes.find(property);
+        if (!index) {
+            return;
+        }
+        index->kinds &= static_cast<uint8_t>(~static_cast<uint8_t>(kind));
+        if (kind == IndexKind::Hash) {
+            index->buckets.clear();
+            index->positions.clear();
+        } else {
+            index->sorted.clear();
+        }
+        if (index->kinds == 0) {
+            indexes.erase(property);
+        }
+    }
+
+    bool has_index(SymbolId property, IndexKind kind) const {
+        const PropertyIndex* index = indexes.find(property);
+        return index && (index->kinds & static_cast<uint8_t>(kind));
+    }
+
+    /**
+     * @brief Does the property have any index?
+     */
+    bool is_indexed(SymbolId property) const { return indexes.contains(property); }
+
+    /**
+     * @brief Rows whose property equals value, in ascending row order
+     *
+     * Uses the hash index when there is one and scans the column otherwise.
+     * Null never matches.
+     */
+    void rows_equal(SymbolId property, Value value, std::pmr::vector<Row>& out) const {
+        out.clear();
+        if (value.is_null()) {
+            return;
+        }
+        if (has_index(property, IndexKind::Hash)) {
+            const PropertyIndex& index = *indexes.find(property);
+            auto bucket = index.buckets.find(value.raw());
+            if (bucket != index.buckets.end()) {
+                out.assign(bucket->second.begin(), bucket->second.end());
+                std::sort(out.begin(), out.end());
+            }
+            return;
+        }
+        if (const std::vector<Value>* column = properties.find(property)) {
+            for (Row row = 0; row < column->size(); ++row) {
+                if ((*column)[row] == value) {
+                    out.push_back(row);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Rows whose property is a number in [low, high], in ascending
+     * row order
+     *
+     * Uses the sorted index when there is one and scans the column
+     * otherwise.
+     */
+    void rows_in_range(SymbolId property, double low, double high,
+                       std::pmr::vector<Row>& out) const {
+        out.clear();
+        if (has_index(property, IndexKind::Sorted)) {
+            const auto& sorted = indexes.find(property)->sorted;
+            auto first = sorted.lower_bound({low, Row{0}});
+            auto last = sorted.upper_bound({high, npos});
+            for (auto it = first; it != last; ++it) {
+                out.push_back(it->second);
+            }
+            std::sort(out.begin(), out.end());
+            return;
+        }
+        if (const std::vector<Value>* column = properties.find(property)) {
+            for (Row row = 0; row < column->size(); ++row) {
+                Value value = (*column)[row];
+                if (value.is_number() && value.as_number() >= low && value.as_number() <= high) {
+                    out.push_back(row);
+                }
+            }
+        }
+    }
+
+    void translate(Row row, double dx, double dy, double dz) {
+        x[row] += dx;
+        y[row] += dy;
+        z[row] += dz;
+    }
+
+    /**
+     * @brief Id of the element at row; valid until it is removed
+     */
+    std::string_view id_at(Row row) const { return names[ids[row]]; }
+    SymbolId type_at(Row row) const { return types[row]; }
+
+    std::span<const SymbolId> get_types() const { return types; }
+    std::span<double> get_x() { return x; }
+    std::span<double> get_y() { return y; }
+    std::span<double> get_z() { return z; }
+    std::span<const double> get_x() const { return x; }
+    std::span<const double> get_y() const { return y; }
+    std::span<const double> get_z() const { return z; }
+
+private:
+    /**
+     * @brief Secondary indexes of one property
+     *
+     * Null values are not indexed, and neither are NaNs in the sorted
+     * index. Rows sit in their hash bucket in no particular order;
+     * positions records where, so a row leaves its bucket in O(1).
+     */
+    struct PropertyIndex {
+        uint8_t kinds = 0;
+        std::unordered_map<uint64_t, std::vector<Row>> buckets;  ///< By Value::raw()
+        std::vector<uint32_t> positions;  ///< Row -> index in its bucket
+        std::set<std::pair<double, Row>> sorted;
+
+        static bool sortable(Value value) {
+            return value.is_number() && value.as_number() == value.as_number();
+        }
+
+        void insert(Row row, Value value) {
+            if (value.is_null()) {
+                return;
+            }
+            if (kinds & static_cast<uint8_t>(IndexKind::Hash)) {
+                std::vector<Row>& bucket = buckets[value.raw()];
+                if (positions.size() <= row) {
+                    positions.resize(row + 1);
+                }
+                positions[row] = static_cast<uint32_t>(bucket.size());
+                bucket.push_back(row);
+            }
+            if ((kinds & static_cast<uint8_t>(IndexKind::Sorted)) && sortable(value)) {
+                sorted.emplace(value.as_number(), row);
+            }
+        }
+
+        void erase(Row row, Value value) {
+            if (value.is_null()) {
+                return;
+            }
+            if (kinds & static_cast<uint8_t>(IndexKind::Hash)) {
+                auto found = buckets.find(value.raw());
+                std::vector<Row>& bucket = found->second;
+                Row moved = bucket.back();
+                bucket[positions[row]] = moved;
+                positions[moved] = positions[row];
+                bucket.pop_back();
+                if (bucket.empty()) {
+                    buckets.erase(found);
+                }
+            }
+            if ((kinds & static_cast<uint8_t>(IndexKind::Sorted)) && sortable(value)) {
+                sorted.erase({value.as_number(), row});
+            }
+        }
+
+        /**
+         * @brief Renumber an entry after its element moved rows
+         */
+        void move(Row from, Row to, Value value) {
+            if (value.is_null()) {
+                return;
+            }
+            if (kinds & static_cast<uint8_t>(IndexKind::Hash)) {
+                buckets.find(value.raw())->second[positions[from]] = to;
+                positions[to] = positions[from];
+            }
+            if ((kinds & static_cast<uint8_t>(IndexKind::Sorted)) && sortable(value)) {
+                sorted.erase({value.as_number(), from});
+                sorted.emplace(value.as_number(), to);
+            }
+        }
+
+        void reset() {
+            buckets.clear();
+            positions.clear();
+            sorted.clear();
+        }
+
+        void rebuild(const std::vector<Value>& column) {
+            reset();
+            for (Row row = 0; row < column.size(); ++row) {
+                insert(row, column[row]);
+            }
+        }
+    };
+
+    std::vector<uint32_t> ids;  ///< Name slot of each row
+    std::vector<SymbolId> types;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> z;
+    SymbolMap<std::vector<Value>> properties;
+    std::deque<std::string> names;  ///< Element ids by name slot; empty when free
+    std::vector<uint32_t> free_names;
+    std::unordered_map<std::string_view, Row> rows;  ///< Keys view into names
+    SymbolMap<PropertyIndex> indexes;
+    uint64_t structure = 0;
+    mutable std::vector<NamedRow> name_index;  ///< Sorted by name
+    mutable uint64_t name_index_version = ~uint64_t{0};
+};
+
+}  // namespace krayon::mini
@@ -0,0 +1,402 @@
+#pragma once
+
+#include "command_schema.hpp"
+#include "value.hpp"
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file expression.hpp
+ * @brief Argument expressions: constant folding, CSE and register programs
+ *
+ * Expressions are built bottom-up into a hash-consed DAG. Operations on
+ * constants are folded as they are built (string constants stay
+ * MiniValues, so folding does not intern them), and structurally identical
+ * subexpressions map to the same node, so `a * 2 + 1` and `a * 2 - 1` in
+ * one command share the `a * 2`. What remains after folding depends on
+ * context variables and is emitted as a small register program: constants
+ * are preloaded into the register file, and each instruction is one load
+ * or one arithmetic operation.
+ *
+ * `+` adds numbers and concatenates when either side is a string; `-`, `*`
+ * and `/` take numbers only. Strings made or loaded while a program runs
+ * are kept in per-run scratch storage, never interned, so generated text
+ * does not accumulate in the global SymbolTable.
+ */
+
+/**
+ * @brief Text of a number when concatenated with a string ("n" + 3 is "n3")
+ */
+inline std::string format_number(double value) {
+    char buffer[32];
+    std::to_chars_result result;
+    if (std::nearbyint(value) == value && std::fabs(value) < 1e15) {
+        result = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<int64_t>(value));
+    } else {
+        result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    }
+    return std::string(buffer, result.ptr);
+}
+
+/**
+ * @brief Text of any value in a string concatenation
+ */
+inline std::string concat_text(Value value) {
+    if (value.is_string()) return std::string(value.as_string());
+    if (value.is_number()) return format_number(value.as_number());
+    if (value.is_bool()) return value.as_bool() ? "true" : "false";
+    return "null";
+}
+
+inline std::string concat_text(const MiniValue& value) {
+    if (const auto* text = std::get_if<std::string>(&value)) {
+        return *text;
+    }
+    return concat_text(Value::from_mini(value));
+}
+
+/**
+ * @brief Expression node and instruction kinds
+ */
+enum class ExprOp : uint8_t {
+    Constant,
+    Variable,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Negate
+};
+
+/**
+ * @brief Apply an arithmetic operation (rhs is ignored for Negate)
+ *
+ * String concatenation is left to the caller, which owns the resulting
+ * text; `+` with a string operand fails here.
+ * @param error Set to a static message on failure
+ */
+inline bool apply_expr_op(ExprOp op, Value lhs, Value rhs, Value& out, const char*& error) {
+    if (op == ExprOp::Negate) {
+        if (!lhs.is_number()) {
+            error = "Operand of unary '-' must be a number";
+            return false;
+        }
+        out = Value::number(-lhs.as_number());
+        return true;
+    }
+    if (!lhs.is_number() || !rhs.is_number()) {
+        error = op == ExprOp::Add ? "Operands of '+' must be numbers or strings"
+                                  : "Operands of arithmetic operators must be numbers";
+        return false;
+    }
+    double a = lhs.as_number();
+    double b = rhs.as_number();
+    switch (op) {
+        case ExprOp::Add: out = Value::number(a + b); return true;
+        case ExprOp::Subtract: out = Value::number(a - b); return true;
+        case ExprOp::Multiply: out = Value::number(a * b); return true;
+        case ExprOp::Divide:
+            if (b == 0.0) {
+                error = "Division by zero";
+                return false;
+            }
+            out = Value::number(a / b);
+            return true;
+        default:
+            error = "Invalid operator";
+            return false;
+    }
+}
+
+class ScriptImageCodec;
+
+/**
+ * @brief Compiled form of the variable-dependent arguments of one command
+ */
+class ExprProgram {
+public:
+    /**
+     * @brief Registers available to one program
+     */
+    static constexpr size_t max_registers = 64;
+
+    /**
+     * @param memory Resource for the program's tables, e.g. a ScriptArena
+     */
+    explicit ExprProgram(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : initial(memory), code(memory), variables(memory), outputs(memory) {}
+
+    struct Instruction {
+        ExprOp op;
+        uint8_t target;
+        uint8_t lhs;  ///< Register, or index into variables for Variable
+        uint8_t rhs;
+    };
+
+    struct Output {
+        uint8_t slot;
+        uint8_t source;
+    };
+
+    /**
+     * @brief Evaluate and write every output into its argument slot
+     *
+     * A register marked in `scratch` holds a string made during this run:
+     * its Value's symbol is an index into `texts`, not a SymbolId. Those
+     * strings come from the context's memory resource.
+     */
+    CommandResult run(const CommandContext& context, BoundArguments& args) const {
+        std::array<Value, max_registers> registers;
+        std::copy(initial.begin(), initial.end(), registers.begin());
+        std::pmr::vector<std::pmr::string> texts(context.get_memory_resource());
+        uint64_t scratch = 0;
+        auto is_scratch = [&](uint8_t r) { return (scratch >> r) & 1; };
+        auto keep = [&](uint8_t r, std::pmr::string text) {
+            registers[r] = Value::symbol(static_cast<SymbolId>(texts.size()));
+            texts.push_back(std::move(text));
+            scratch |= uint64_t{1} << r;
+        };
+        auto append_text = [&](uint8_t r, std::pmr::string& out) {
+            if (is_scratch(r)) {
+                out += texts[registers[r].as_symbol()];
+            } else if (registers[r].is_string()) {
+                out += registers[r].as_string();
+            } else {
+                out += concat_text(registers[r]);
+            }
+        };
+
+        const char* error = nullptr;
+        for (const Instruction& in : code) {
+            if (in.op == ExprOp::Variable) {
+                const MiniValue* value = context.find_variable(variables[in.lhs]);
+                if (!value) {
+                    return CommandResult(false, "Undefined variable: " +
+                                                    std::string(SymbolTable::global().name(
+                                                        variables[in.lhs])));
+                }
+                if (const auto* text = std::get_if<std::string>(value)) {
+                    keep(in.target, std::pmr::string(*text, texts.get_allocator()));
+                } else {
+                    registers[in.target] = Value::from_mini(*value);
+                }
+            } else if (in.op == ExprOp::Add &&
+                       (registers[in.lhs].is_string() || registers[in.rhs].is_string())) {
+                std::pmr::string text(texts.get_allocator());
+                append_text(in.lhs, text);
+                append_text(in.rhs, text);
+                keep(in.target, std::move(text));
+            } else if (!apply_expr_op(in.op, registers[in.lhs], registers[in.rhs],
+                                      registers[in.target], error)) {
+                return CommandResult(false, error);
+            }
+        }
+        for (const Output& output : outputs) {
+            if (is_scratch(output.source)) {
+                args.set(output.slot, std::string(texts[registers[output.source].as_symbol()]));
+            } else {
+                args.set(output.slot, registers[output.source].to_mini());
+            }
+        }
+        return CommandResult(true);
+    }
+
+    /**
+     * @brief Context variables the program reads
+     */
+    std::span<const SymbolId> get_variables() const { return variables; }
+
+    /**
+     * @brief Bit i set when the program writes argument slot i
+     */
+    uint32_t slot_mask() const {
+        uint32_t mask = 0;
+        for (const Output& output : outputs) {
+            mask |= uint32_t{1} << output.slot;
+        }
+        return mask;
+    }
+
+    size_t instruction_count() const { return code.size(); }
+
+private:
+    friend class ExprBuilder;
+    friend class ScriptImageCodec;
+
+    std::pmr::vector<Value> initial;  ///< Register file prefix holding the constants
+    std::pmr::vector<Instruction> code;
+    std::pmr::vector<SymbolId> variables;
+    std::pmr::vector<Output> outputs;
+};
+
+/**
+ * @brief Hash-consed expression DAG with constant folding
+ */
+class ExprBuilder {
+public:
+    using Node = uint32_t;
+
+    /**
+     * @param memory Resource for the DAG and emit() scratch
+     */
+    explicit ExprBuilder(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : nodes(memory), index(memory) {}
+
+    struct Entry {
+        ExprOp op;
+        MiniValue constant;                  ///< Constant nodes
+        SymbolId variable = invalid_symbol;  ///< Variable nodes
+        Node lhs = 0;
+        Node rhs = 0;
+    };
+
+    Node constant(MiniValue value) {
+        return intern_node({ExprOp::Constant, std::move(value), invalid_symbol, 0, 0});
+    }
+
+    Node variable(SymbolId name) {
+        return intern_node({ExprOp::Variable, MiniValue(), name, 0, 0});
+    }
+
+    /**
+     * @brief lhs op rhs, folded when both sides are constant
+     * @param error Set to a static message if folding fails
+     */
+    bool binary(ExprOp op, Node lhs, Node rhs, Node& out, const char*& error) {
+        if (is_constant(lhs) && is_constant(rhs)) {
+            return fold(op, nodes[lhs].constant, nodes[rhs].constant, out, error);
+        }
+        // '*' only ever applies to numbers, so operand order is irrelevant.
+        if (op == ExprOp::Multiply && lhs > rhs) {
+            std::swap(lhs, rhs);
+        }
+        out = intern_node({op, MiniValue(), invalid_symbol, lhs, rhs});
+        return true;
+    }
+
+    bool negate(Node operand, Node& out, const char*& error) {
+        if (is_constant(operand)) {
+            return fold(ExprOp::Negate, nodes[operand].constant, MiniValue(), out, error);
+        }
+        out = intern_node({ExprOp::Negate, MiniValue(), invalid_symbol, operand, operand});
+        return true;
+    }
+
+    bool is_constant(Node node) const { return nodes[node].op == ExprOp::Constant; }
+
+    const Entry& get(Node node) const { return nodes[node]; }
+
+    /**
+     * @brief Emit one program computing every (slot, root) output
+     * @return false if the expressions need more than max_registers
+     */
+    bool emit(std::span<const std::pair<uint8_t, Node>> roots, ExprProgram& program) const {
+        std::pmr::memory_resource* memory = nodes.get_allocator().resource();
+        std::pmr::vector<bool> live(nodes.size(), false, memory);
+        for (const auto& root : roots) {
+            live[root.second] = true;
+        }
+        // Children always precede their parents, so one backward pass
+        // marks everything reachable.
+        for (size_t i = nodes.size(); i-- > 0;) {
+            if (live[i] && nodes[i].op != ExprOp::Constant && nodes[i].op != ExprOp::Variable) {
+                live[nodes[i].lhs] = true;
+                live[nodes[i].rhs] = true;
+            }
+        }
+
+        std::pmr::vector<uint8_t> registers(nodes.size(), 0, memory);
+        size_t next = 0;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (live[i] && nodes[i].op == ExprOp::Constant) {
+                if (next == ExprProgram::max_registers) {
+                    return false;
+                }
+                registers[i] = static_cast<uint8_t>(next++);
+                program.initial.push_back(Value::from_mini(nodes[i].constant));
+            }
+        }
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const Entry& node = nodes[i];
+            if (!live[i] || node.op == ExprOp::Constant) {
+                continue;
+            }
+            if (next == ExprProgram::max_registers) {
+                return false;
+            }
+            registers[i] = static_cast<uint8_t>(next++);
+            if (node.op == ExprOp::Variable) {
+                program.code.push_back({ExprOp::Variable, registers[i],
+                                        static_cast<uint8_t>(program.variables.size()), 0});
+                program.variables.push_back(node.variable);
+            } else {
+                program.code.push_back({node.op, registers[i], registers[node.lhs],
+                                        registers[node.rhs]});
+            }
+        }
+        for (const auto& root : roots) {
+            program.outputs.push_back({root.first, registers[root.second]});
+        }
+        return true;
+    }
+
+private:
+    std::pmr::vector<Entry> nodes;
+    std::pmr::unordered_map<uint64_t, std::pmr::vector<Node>> index;
+
+    static uint64_t key_of(const Entry& entry) {
+        uint64_t payload = entry.op == ExprOp::Constant   ? std::hash<MiniValue>()(entry.constant)
+                           : entry.op == ExprOp::Variable ? entry.variable
+                                                          : (uint64_t{entry.lhs} << 32 | entry.rhs);
+        return (payload * 0x9E3779B97F4A7C15ull) ^ static_cast<uint64_t>(entry.op);
+    }
+
+    bool fold(ExprOp op, const MiniValue& lhs, const MiniValue& rhs, Node& out,
+              const char*& error) {
+        bool lhs_text = std::holds_alternative<std::string>(lhs);
+        bool rhs_text = std::holds_alternative<std::string>(rhs);
+        if (op == ExprOp::Add && (lhs_text || rhs_text)) {
+            out = constant(concat_text(lhs) + concat_text(rhs));
+            return true;
+        }
+        // Any other operation on a string fails; check it here so the
+        // string is not interned by the conversion to Value.
+        Value folded;
+        if (!apply_expr_op(op, lhs_text ? Value() : Value::from_mini(lhs),
+                           rhs_text ? Value() : Value::from_mini(rhs), folded, error)) {
+            return false;
+        }
+        out = constant(folded.to_mini());
+        return true;
+    }
+
+    static bool same(const Entry& a, const Entry& b) {
+        return a.op == b.op && a.constant == b.constant && a.variable == b.variable &&
+               a.lhs == b.lhs && a.rhs == b.rhs;
+    }
+
+    Node intern_node(const Entry& entry) {
+        std::pmr::vector<Node>& bucket = index[key_of(entry)];
+        for (Node node : bucket) {
+            if (same(nodes[node], entry)) {
+                return node;
+            }
+        }
+        nodes.push_back(entry);
+        bucket.push_back(static_cast<Node>(nodes.size() - 1));
+        return bucket.back();
+    }
+};
+
+}  // namespace krayon::mini
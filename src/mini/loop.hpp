@@ -0,0 +1,639 @@
+#pragma once
+
+#include "builtin_commands.hpp"
+#include "command_schema.hpp"
+#include "element_store.hpp"
+#include "expression.hpp"
+#include "sealed_registry.hpp"
+#include "selector.hpp"
+#include "transaction.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file loop.hpp
+ * @brief Compiled `for` loops and their bulk columnar execution
+ *
+ *     for i in 0..1000000 { create_element(type: "node", name: "n" + i, x: i * 2) }
+ *
+ * A loop is stored once, not unrolled. Body arguments that are affine in
+ * the induction variable (`a * i + b`, optionally wrapped in a string
+ * prefix and suffix as in "n" + i) are kept in closed form; any other
+ * expression becomes an ExprProgram reading the loop variable from the
+ * context. When every body command is a builtin element operation keyed
+ * by the same closed-form id (see classify_bulk()) and the context has an
+ * ElementStore, the loop runs as a few passes over whole columns instead
+ * of N interpreted iterations. Any other loop, or any loop inside a transaction, is
+ * interpreted one iteration at a time.
+ */
+
+/**
+ * @brief Argument expression over the induction variable i
+ */
+struct LoopExpr {
+    enum class Kind : uint8_t {
+        Constant,  ///< Same value every iteration
+        Affine,    ///< scale * i + offset
+        Concat     ///< prefix + text(scale * i + offset) + suffix
+    };
+
+    Kind kind = Kind::Constant;
+    MiniValue constant;
+    double scale = 0.0;
+    double offset = 0.0;
+    std::string prefix;
+    std::string suffix;
+
+    static LoopExpr make_constant(MiniValue value) {
+        LoopExpr expr;
+        expr.constant = std::move(value);
+        return expr;
+    }
+
+    static LoopExpr make_affine(double scale, double offset) {
+        if (scale == 0.0) {
+            return make_constant(offset);
+        }
+        LoopExpr expr;
+        expr.kind = Kind::Affine;
+        expr.scale = scale;
+        expr.offset = offset;
+        return expr;
+    }
+
+    static LoopExpr induction() { return make_affine(1.0, 0.0); }
+
+    /**
+     * @brief Read the expression as scale * i + offset, if it is numeric
+     */
+    bool as_affine(double& s, double& o) const {
+        if (kind == Kind::Affine) {
+            s = scale;
+            o = offset;
+            return true;
+        }
+        if (kind == Kind::Constant && std::holds_alternative<double>(constant)) {
+            s = 0.0;
+            o = std::get<double>(constant);
+            return true;
+        }
+        return false;
+    }
+
+    const std::string* as_string() const {
+        return kind == Kind::Constant ? std::get_if<std::string>(&constant) : nullptr;
+    }
+
+    double number_at(int64_t i) const { return scale * static_cast<double>(i) + offset; }
+
+    template <typename String>
+    void append_text_at(int64_t i, String& out) const {
+        out += prefix;
+        out += format_number(number_at(i));
+        out += suffix;
+    }
+
+    MiniValue evaluate(int64_t i) const {
+        switch (kind) {
+            case Kind::Affine:
+                return number_at(i);
+            case Kind::Concat: {
+                std::string text;
+                append_text_at(i, text);
+                return text;
+            }
+            case Kind::Constant:
+                break;
+        }
+        return constant;
+    }
+
+    bool operator==(const LoopExpr& other) const = default;
+};
+
+/**
+ * @brief lhs + rhs, or nullopt if the result is not a LoopExpr
+ *
+ * Numbers add; a string on either side concatenates.
+ */
+inline std::optional<LoopExpr> loop_add(const LoopExpr& lhs, const LoopExpr& rhs) {
+    double ls = 0.0, lo = 0.0, rs = 0.0, ro = 0.0;
+    bool lhs_numeric = lhs.as_affine(ls, lo);
+    bool rhs_numeric = rhs.as_affine(rs, ro);
+    if (lhs_numeric && rhs_numeric) {
+        return LoopExpr::make_affine(ls + rs, lo + ro);
+    }
+
+    const std::string* lhs_text = lhs.as_string();
+    const std::string* rhs_text = rhs.as_string();
+    if (lhs_text && rhs_text) {
+        return LoopExpr::make_constant(*lhs_text + *rhs_text);
+    }
+    if (lhs_text && rhs_numeric) {
+        if (rs == 0.0) {
+            return LoopExpr::make_constant(*lhs_text + format_number(ro));
+        }
+        LoopExpr expr = rhs;
+        expr.kind = LoopExpr::Kind::Concat;
+        expr.prefix = *lhs_text;
+        return expr;
+    }
+    if (lhs_text && rhs.kind == LoopExpr::Kind::Concat) {
+        LoopExpr expr = rhs;
+        expr.prefix = *lhs_text + expr.prefix;
+        return expr;
+    }
+    if (rhs_text && lhs_numeric) {
+        if (ls == 0.0) {
+            return LoopExpr::make_constant(format_number(lo) + *rhs_text);
+        }
+        LoopExpr expr = lhs;
+        expr.kind = LoopExpr::Kind::Concat;
+        expr.suffix = *rhs_text;
+        return expr;
+    }
+    if (lhs.kind == LoopExpr::Kind::Concat && (rhs_text || (rhs_numeric && rs == 0.0))) {
+        LoopExpr expr = lhs;
+        expr.suffix += rhs_text ? *rhs_text : format_number(ro);
+        return expr;
+    }
+    return std::nullopt;
+}
+
+inline std::optional<LoopExpr> loop_negate(const LoopExpr& operand) {
+    double s = 0.0, o = 0.0;
+    if (!operand.as_affine(s, o)) {
+        return std::nullopt;
+    }
+    return LoopExpr::make_affine(-s, -o);
+}
+
+inline std::optional<LoopExpr> loop_subtract(const LoopExpr& lhs, const LoopExpr& rhs) {
+    double ls = 0.0, lo = 0.0, rs = 0.0, ro = 0.0;
+    if (!lhs.as_affine(ls, lo) || !rhs.as_affine(rs, ro)) {
+        return std::nullopt;
+    }
+    return LoopExpr::make_affine(ls - rs, lo - ro);
+}
+
+/**
+ * @brief lhs * rhs; one side must not depend on i
+ */
+inline std::optional<LoopExpr> loop_multiply(const LoopExpr& lhs, const LoopExpr& rhs) {
+    double ls = 0.0, lo = 0.0, rs = 0.0, ro = 0.0;
+    if (!lhs.as_affine(ls, lo) || !rhs.as_affine(rs, ro) || (ls != 0.0 && rs != 0.0)) {
+        return std::nullopt;
+    }
+    return LoopExpr::make_affine(ls * ro + rs * lo, lo * ro);
+}
+
+/**
+ * @brief lhs / rhs; rhs must be a non-zero constant
+ */
+inline std::optional<LoopExpr> loop_divide(const LoopExpr& lhs, const LoopExpr& rhs) {
+    double ls = 0.0, lo = 0.0, rs = 0.0, ro = 0.0;
+    if (!lhs.as_affine(ls, lo) || !rhs.as_affine(rs, ro) || rs != 0.0 || ro == 0.0) {
+        return std::nullopt;
+    }
+    return LoopExpr::make_affine(ls / ro, lo / ro);
+}
+
+/**
+ * @brief Closed form of an expression node over the loop variable
+ * @return nullopt if the expression is not affine in the variable or
+ * reads any other variable
+ */
+inline std::optional<LoopExpr> to_loop_expr(const ExprBuilder& builder, ExprBuilder::Node node,
+                                            SymbolId variable) {
+    const ExprBuilder::Entry& entry = builder.get(node);
+    switch (entry.op) {
+        case ExprOp::Constant:
+            return LoopExpr::make_constant(entry.constant);
+        case ExprOp::Variable:
+            if (entry.variable != variable) {
+                return std::nullopt;
+            }
+            return LoopExpr::induction();
+        default:
+            break;
+    }
+
+    auto lhs = to_loop_expr(builder, entry.lhs, variable);
+    if (!lhs) {
+        return std::nullopt;
+    }
+    if (entry.op == ExprOp::Negate) {
+        return loop_negate(*lhs);
+    }
+    auto rhs = to_loop_expr(builder, entry.rhs, variable);
+    if (!rhs) {
+        return std::nullopt;
+    }
+    switch (entry.op) {
+        case ExprOp::Add: return loop_add(*lhs, *rhs);
+        case ExprOp::Subtract: return loop_subtract(*lhs, *rhs);
+        case ExprOp::Multiply: return loop_multiply(*lhs, *rhs);
+        case ExprOp::Divide: return loop_divide(*lhs, *rhs);
+        default: return std::nullopt;
+    }
+}
+
+/**
+ * @brief A body argument whose value changes with the iteration
+ */
+struct LoopArgument {
+    uint8_t slot = 0;
+    LoopExpr expr;
+};
+
+/**
+ * @brief Columnar equivalent of a builtin body command
+ */
+enum class BulkOp : uint8_t {
+    None,  ///< No columnar form; the loop is interpreted
+    Create,
+    Delete,
+    SetProperty,
+    Move
+};
+
+/**
+ * @brief One command of a loop body
+ *
+ * command.args holds the constant arguments, plus the first iteration's
+ * value of each varying one so the schema's type checks apply.
+ */
+struct LoopBodyCommand {
+    CompiledCommand command;
+    std::vector<LoopArgument> varying;
+    BulkOp op = BulkOp::None;
+
+    const LoopExpr* varying_at(int slot) const {
+        for (const LoopArgument& argument : varying) {
+            if (argument.slot == slot) {
+                return &argument.expr;
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * @brief `for variable in begin..end { body }` (end exclusive)
+ */
+struct CompiledLoop {
+    SymbolId variable = invalid_symbol;
+    int64_t begin = 0;
+    int64_t end = 0;
+    std::vector<LoopBodyCommand> body;
+    std::optional<LoopExpr> bulk_key;  ///< Per-iteration element id, when bulk-eligible
+
+    size_t iterations() const { return end > begin ? static_cast<size_t>(end - begin) : 0; }
+};
+
+/**
+ * @brief Decide whether a loop can run as bulk column operations
+ *
+ * Every body command must be one of the builtin element command classes
+ * (transform only with operation "move"), called without selectors, whose
+ * element key is the same string expression with a non-zero step. A
+ * command merely registered under a builtin's name is run as registered.
+ * Distinct iterations then touch distinct elements, so running each
+ * command over all iterations before the next command gives the same
+ * result as running the iterations in order. The exception is row order:
+ * a delete moves the last row into the freed one, so a body that both
+ * creates and deletes is interpreted.
+ *
+ * Element types, property names and string property values must be the
+ * same on every iteration: stored strings are interned, and the bulk
+ * path does not intern one string per iteration.
+ */
+inline void classify_bulk(CompiledLoop& loop) {
+    loop.bulk_key.reset();
+    std::optional<LoopExpr> key;
+    bool creates = false;
+    bool deletes = false;
+    auto varies = [](const LoopBodyCommand& body, const char* name) {
+        return body.varying_at(body.command.schema->slot_of(intern(name))) != nullptr;
+    };
+    for (LoopBodyCommand& body : loop.body) {
+        if (body.command.program || body.command.selector_slots) {
+            return;
+        }
+        int builtin = builtin_commands::builtin_index_of(*body.command.command);
+        std::string_view name = builtin >= 0 ? builtin_command_names[static_cast<size_t>(builtin)]
+                                             : std::string_view();
+        const char* key_name = "id";
+        if (name == "create_element") {
+            body.op = BulkOp::Create;
+            key_name = "name";
+        } else if (name == "delete_element") {
+            body.op = BulkOp::Delete;
+        } else if (name == "set_property") {
+            body.op = BulkOp::SetProperty;
+        } else if (name == "transform") {
+            int slot = body.command.schema->slot_of(intern("operation"));
+            const MiniValue* operation = slot >= 0 && !body.varying_at(slot)
+                                             ? body.command.args.get(static_cast<size_t>(slot))
+                                             : nullptr;
+            const auto* text = operation ? std::get_if<std::string>(operation) : nullptr;
+            body.op = text && *text == "move" ? BulkOp::Move : BulkOp::None;
+        } else {
+            body.op = BulkOp::None;
+        }
+        if (body.op == BulkOp::None) {
+            return;
+        }
+        creates |= body.op == BulkOp::Create;
+        deletes |= body.op == BulkOp::Delete;
+        if (creates && deletes) {
+            return;
+        }
+        if (body.op == BulkOp::Create && varies(body, "type")) {
+            return;
+        }
+        if (body.op == BulkOp::SetProperty) {
+            const LoopExpr* value = body.varying_at(body.command.schema->slot_of(intern("value")));
+            if (varies(body, "property") || (value && value->kind != LoopExpr::Kind::Affine)) {
+                return;
+            }
+        }
+
+        const LoopExpr* body_key = body.varying_at(body.command.schema->slot_of(intern(key_name)));
+        if (!body_key || body_key->kind != LoopExpr::Kind::Concat || (key && *key != *body_key)) {
+            return;
+        }
+        key = *body_key;
+    }
+    loop.bulk_key = std::move(key);
+}
+
+/**
+ * @brief Compute the arguments of a command with a program, in place
+ *
+ * Only arguments computed by the program are checked here; the rest were
+ * validated at compile time.
+ */
+inline CommandResult evaluate_arguments(const CompiledCommand& compiled, BoundArguments& bound,
+                                        const CommandContext& context) {
+    CommandResult status = compiled.program->run(context, bound);
+    if (status.success) {
+        status = compiled.schema->check_kinds(bound, compiled.program->slot_mask());
+    }
+    if (status.success && !compiled.selector_slots) {
+        status = compiled.slot_command
+                     ? compiled.slot_command->validate_slots(bound)
+                     : compiled.command->validate_parameters(compiled.schema->to_map(bound));
+    }
+    return status;
+}
+
+/**
+ * @brief Run a command whose arguments are all computed
+ *
+ * Element changes are recorded instead while a transaction is open.
+ */
+inline CommandResult execute_bound(const CompiledCommand& compiled, const BoundArguments& args,
+                                   CommandContext& context) {
+    if (const auto& log = context.get_write_log(); log && WriteLog::buffers(compiled)) {
+        return log->record(compiled, args);
+    }
+    if (compiled.selector_slots) {
+        return execute_selection(compiled, args, context);
+    }
+    if (compiled.slot_command) {
+        return compiled.slot_command->execute_slots(args, context);
+    }
+    return compiled.command->execute(compiled.schema->to_map(args), context);
+}
+
+/**
+ * @brief Run a command with explicit arguments
+ */
+inline CommandResult execute_with_arguments(const CompiledCommand& compiled,
+                                            const BoundArguments& args,
+                                            CommandContext& context) {
+    if (compiled.program) {
+        BoundArguments bound = args;
+        CommandResult status = evaluate_arguments(compiled, bound, context);
+        if (!status.success) {
+            return status;
+        }
+        return execute_bound(compiled, bound, context);
+    }
+    return execute_bound(compiled, args, context);
+}
+
+namespace detail {
+
+/**
+ * @brief Per-iteration numbers of a slot: a full column, or one shared value
+ */
+inline void fill_numbers(const LoopBodyCommand& body, const char* name, int64_t begin,
+                         size_t count, std::pmr::vector<double>& out) {
+    int slot = body.command.schema->slot_of(intern(name));
+    if (const LoopExpr* expr = slot >= 0 ? body.varying_at(slot) : nullptr) {
+        out.resize(count);
+        double scale = expr->scale;
+        double offset = expr->offset + scale * static_cast<double>(begin);
+        for (size_t k = 0; k < count; ++k) {
+            out[k] = scale * static_cast<double>(k) + offset;
+        }
+        return;
+    }
+    const MiniValue* value = slot >= 0 ? body.command.args.get(static_cast<size_t>(slot)) : nullptr;
+    const double* number = value ? std::get_if<double>(value) : nullptr;
+    out.assign(1, number ? *number : 0.0);
+}
+
+/**
+ * @brief Symbol of a string slot, the same on every iteration (see classify_bulk())
+ */
+inline SymbolId symbol_of(const LoopBodyCommand& body, const char* name) {
+    int slot = body.command.schema->slot_of(intern(name));
+    const MiniValue* value = slot >= 0 ? body.command.args.get(static_cast<size_t>(slot)) : nullptr;
+    const auto* text = value ? std::get_if<std::string>(value) : nullptr;
+    return intern(text ? *text : std::string());
+}
+
+}  // namespace detail
+
+/**
+ * @brief Run a bulk-eligible loop as column operations on a store
+ * @param first_error Receives the message of the failure that comes first
+ * in iteration order, as an interpreted run would report it
+ * @param memory Resource for the per-iteration keys and columns
+ * @return Number of body command applications that failed
+ */
+inline size_t execute_loop_bulk(const CompiledLoop& loop, ElementStore& store,
+                                std::string& first_error, std::pmr::memory_resource* memory) {
+    size_t count = loop.iterations();
+    std::pmr::vector<std::pmr::string> keys(count, memory);
+    for (size_t k = 0; k < count; ++k) {
+        loop.bulk_key->append_text_at(loop.begin + static_cast<int64_t>(k), keys[k]);
+    }
+
+    // Commands run one after another over all iterations, so the failure
+    // reported is the one with the lowest (iteration, body command).
+    size_t failures = 0;
+    size_t first_at = SIZE_MAX;
+    size_t command = 0;
+    auto fail = [&](const char* message, size_t k) {
+        ++failures;
+        size_t at = k * loop.body.size() + command;
+        if (at < first_at) {
+            first_at = at;
+            first_error = message;
+            first_error += keys[k];
+        }
+    };
+
+    std::pmr::vector<double> xs(memory), ys(memory), zs(memory);
+    auto at = [](const auto& column, size_t k) { return column.size() == 1 ? column[0] : column[k]; };
+
+    for (; command < loop.body.size(); ++command) {
+        const LoopBodyCommand& body = loop.body[command];
+        switch (body.op) {
+            case BulkOp::Create: {
+                SymbolId type = detail::symbol_of(body, "type");
+                detail::fill_numbers(body, "x", loop.begin, count, xs);
+                detail::fill_numbers(body, "y", loop.begin, count, ys);
+                store.reserve(store.size() + count);
+                for (size_t k = 0; k < count; ++k) {
+                    if (!store.create(keys[k], type, at(xs, k), at(ys, k))) {
+                        fail("Element already exists: ", k);
+                    }
+                }
+                break;
+            }
+            case BulkOp::Delete: {
+                for (size_t k = 0; k < count; ++k) {
+                    if (!store.remove(keys[k])) {
+                        fail("Element not found: ", k);
+                    }
+                }
+                break;
+            }
+            case BulkOp::SetProperty: {
+                SymbolId property = detail::symbol_of(body, "property");
+                int slot = body.command.schema->slot_of(intern("value"));
+                const LoopExpr* expr = body.varying_at(slot);
+                Value constant = expr ? Value() : Value::from_mini(body.command.args.values[static_cast<size_t>(slot)]);
+                auto value_at = [&](size_t k) {
+                    return expr ? Value::number(expr->number_at(loop.begin + static_cast<int64_t>(k)))
+                                : constant;
+                };
+
+                if (!store.is_indexed(property)) {
+                    std::vector<Value>& column = store.property_column(property);
+                    for (size_t k = 0; k < count; ++k) {
+                        ElementStore::Row row = store.find(keys[k]);
+                        if (row == ElementStore::npos) {
+                            fail("Element not found: ", k);
+                            continue;
+                        }
+                        column[row] = value_at(k);
+                    }
+                } else {
+                    std::pmr::vector<ElementStore::RowValue> writes(memory);
+                    writes.reserve(count);
+                    for (size_t k = 0; k < count; ++k) {
+                        ElementStore::Row row = store.find(keys[k]);
+                        if (row == ElementStore::npos) {
+                            fail("Element not found: ", k);
+                            continue;
+                        }
+                        writes.push_back({row, value_at(k)});
+                    }
+                    store.set_properties(property, writes);
+                }
+                break;
+            }
+            case BulkOp::Move: {
+                detail::fill_numbers(body, "x", loop.begin, count, xs);
+                detail::fill_numbers(body, "y", loop.begin, count, ys);
+                detail::fill_numbers(body, "z", loop.begin, count, zs);
+                for (size_t k = 0; k < count; ++k) {
+                    ElementStore::Row row = store.find(keys[k]);
+                    if (row == ElementStore::npos) {
+                        fail("Element not found: ", k);
+                        continue;
+                    }
+                    store.translate(row, at(xs, k), at(ys, k), at(zs, k));
+                }
+                break;
+            }
+            case BulkOp::None:
+                break;
+        }
+    }
+    return failures;
+}
+
+/**
+ * @brief Run a compiled loop
+ *
+ * Uses the bulk path when the loop qualifies and the context has an
+ * ElementStore; otherwise runs the body once per iteration with the loop
+ * variable set in the context. Either way the loop yields one result:
+ * success if every body command succeeded, otherwise the first failure's
+ * message and the failure count. The return value is the iteration count,
+ * and the loop variable is left at its last value.
+ */
+inline CommandResult execute_loop(const CompiledLoop& loop, CommandContext& context) {
+    size_t count = loop.iterations();
+    size_t total = count * loop.body.size();
+    if (count == 0) {
+        return CommandResult(true, "", 0.0);
+    }
+
+    size_t failures = 0;
+    std::string first_error;
+    if (loop.bulk_key && context.get_element_store() && !context.get_write_log()) {
+        failures = execute_loop_bulk(loop, *context.get_element_store(), first_error,
+                                     context.get_memory_resource());
+        context.set_variable(loop.variable, static_cast<double>(loop.end - 1));
+    } else {
+        BoundArguments args;
+        for (int64_t i = loop.begin; i < loop.end; ++i) {
+            context.set_variable(loop.variable, static_cast<double>(i));
+            for (const LoopBodyCommand& body : loop.body) {
+                args = body.command.args;
+                for (const LoopArgument& argument : body.varying) {
+                    args.values[argument.slot] = argument.expr.evaluate(i);
+                }
+                CommandResult result = execute_with_arguments(body.command, args, context);
+                if (!result.success && failures++ == 0) {
+                    first_error = result.message;
+                }
+            }
+        }
+    }
+
+    if (failures > 0) {
+        return CommandResult(false, first_error + " (" + std::to_string(failures) + " of " +
+                                        std::to_string(total) + " commands failed)",
+                             static_cast<double>(count));
+    }
+    return CommandResult(true, "", static_cast<double>(count));
+}
+
+/**
+ * @brief Run a compiled command or loop without re-validating its arguments
+ */
+inline CommandResult execute_compiled(const CompiledCommand& compiled,
+                                      CommandContext& context) {
+    if (compiled.loop) {
+        return execute_loop(*compiled.loop, context);
+    }
+    return execute_with_arguments(compiled, compiled.args, context);
+}
+
+}  // namespace krayon::mini
@@ -10,6 +10,12 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <memory_resource>
+#include <charconv>
+
+#include "number_parse.hpp"
+#include "persistent_map.hpp"
+#include "symbol_table.hpp"
 
 namespace krayon::mini {
 
@@ -29,6 +35,9 @@ namespace krayon::mini {
 class SceneCommand;
 class CommandContext;
 class MiniLangParser;
+class Value;
+class ElementStore;
+class WriteLog;
 
 /**
  * @brief Represents a value in the mini language
@@ -67,45 +76,158 @@ struct CommandResult {
         : success(success), message(msg), return_value(value) {}
 };
 
+/**
+ * @brief Receives the variable accesses made through a CommandContext
+ */
+class ContextObserver {
+public:
+    virtual ~ContextObserver() = default;
+    
+    virtual void on_variable_read(SymbolId name) = 0;
+    virtual void on_variable_write(SymbolId name) = 0;
+};
+
 /**
  * @brief Context for command execution
+ *
+ * Variables live in a persistent map, so copying a context, taking a
+ * variable snapshot and restoring one are all O(1).
  */
 class CommandContext {
 public:
+    /**
+     * @brief Saved variable state, see snapshot_variables()
+     */
+    using VariableSnapshot = PersistentSymbolMap<MiniValue>;
+    
     CommandContext() = default;
     
     /**
      * @brief Set a variable in the context
      */
     void set_variable(const std::string& name, const MiniValue& value) {
-        variables[name] = value;
+        set_variable(intern(name), value);
+    }
+    
+    void set_variable(SymbolId name, const MiniValue& value) {
+        if (observer) {
+            observer->on_variable_write(name);
+        }
+        variables.insert_or_assign(name, value);
     }
     
     /**
      * @brief Get a variable from the context
      */
     std::optional<MiniValue> get_variable(const std::string& name) const {
-        auto it = variables.find(name);
-        if (it != variables.end()) {
-            return it->second;
+        auto id = observer ? std::optional<SymbolId>(intern(name)) : SymbolTable::global().find(name);
+        if (id) {
+            return get_variable(*id);
+        }
+        return std::nullopt;
+    }
+    
+    std::optional<MiniValue> get_variable(SymbolId name) const {
+        if (const MiniValue* value = find_variable(name)) {
+            return *value;
         }
         return std::nullopt;
     }
     
+    /**
+     * @brief Variable value without copying, or nullptr
+     */
+    const MiniValue* find_variable(SymbolId name) const {
+        if (observer) {
+            observer->on_variable_read(name);
+        }
+        return variables.find(name);
+    }
+    
     /**
      * @brief Check if a variable exists
      */
     bool has_variable(const std::string& name) const {
-        return variables.find(name) != variables.end();
+        auto id = observer ? std::optional<SymbolId>(intern(name)) : SymbolTable::global().find(name);
+        return id && has_variable(*id);
+    }
+    
+    bool has_variable(SymbolId name) const {
+        return find_variable(name) != nullptr;
     }
     
+    /**
+     * @brief Remove one variable
+     */
+    void remove_variable(SymbolId name) {
+        if (observer) {
+            observer->on_variable_write(name);
+        }
+        variables.erase(name);
+    }
+
     /**
      * @brief Clear all variables
+     *
+     * The observer sees a write of every variable removed.
      */
     void clear_variables() {
+        if (observer) {
+            variables.for_each([&](SymbolId name, const MiniValue&) {
+                observer->on_variable_write(name);
+            });
+        }
         variables.clear();
     }
     
+    /**
+     * @brief Current variables; later writes do not affect the snapshot
+     */
+    VariableSnapshot snapshot_variables() const {
+        return variables;
+    }
+    
+    /**
+     * @brief Roll the variables back (or forward) to a snapshot
+     *
+     * The observer sees a write of every variable the snapshot adds,
+     * removes or changes.
+     */
+    void restore_variables(VariableSnapshot snapshot) {
+        if (observer && !variables.shares_root_with(snapshot)) {
+            variables.for_each([&](SymbolId name, const MiniValue& value) {
+                const MiniValue* restored = snapshot.find(name);
+                if (!restored || !(*restored == value)) {
+                    observer->on_variable_write(name);
+                }
+            });
+            snapshot.for_each([&](SymbolId name, const MiniValue&) {
+                if (!variables.find(name)) {
+                    observer->on_variable_write(name);
+                }
+            });
+        }
+        variables = std::move(snapshot);
+    }
+    
+    /**
+     * @brief Independent copy for "what-if" previews
+     *
+     * Variables are shared until either side writes them. The element
+     * store is shared as well; give the fork its own with
+     * set_element_store() to preview element edits. The observer, any
+     * open transaction and the batch memory resource are not carried
+     * over; the fork allocates from the default resource, since it may
+     * outlive the batch.
+     */
+    CommandContext fork() const {
+        CommandContext copy(*this);
+        copy.observer = nullptr;
+        copy.write_log = nullptr;
+        copy.memory_resource = std::pmr::get_default_resource();
+        return copy;
+    }
+    
     /**
      * @brief Get the current scene id (if available)
      */
@@ -119,10 +241,64 @@ public:
     void set_scene_id(const std::string& id) {
         scene_id = id;
     }
+    
+    /**
+     * @brief Resource for allocations scoped to the current batch
+     *
+     * Defaults to the global heap; batch executors point it at a ScriptArena
+     * so per-command scratch data is released in one shot.
+     */
+    std::pmr::memory_resource* get_memory_resource() const {
+        return memory_resource;
+    }
+    
+    void set_memory_resource(std::pmr::memory_resource* resource) {
+        memory_resource = resource ? resource : std::pmr::get_default_resource();
+    }
+    
+    /**
+     * @brief Columnar element table backing bulk loop execution (may be null)
+     */
+    const std::shared_ptr<ElementStore>& get_element_store() const {
+        return element_store;
+    }
+    
+    void set_element_store(std::shared_ptr<ElementStore> store) {
+        element_store = std::move(store);
+    }
+    
+    /**
+     * @brief Observer notified of variable reads and writes (may be null)
+     *
+     * Used by dependency-tracking executors; reads of names never
+     * interned are reported too, so a later definition can be detected.
+     */
+    ContextObserver* get_observer() const {
+        return observer;
+    }
+    
+    void set_observer(ContextObserver* value) {
+        observer = value;
+    }
+    
+    /**
+     * @brief Write log of the open transaction (null outside `begin`/`commit`)
+     */
+    const std::shared_ptr<WriteLog>& get_write_log() const {
+        return write_log;
+    }
+    
+    void set_write_log(std::shared_ptr<WriteLog> log) {
+        write_log = std::move(log);
+    }
 
 private:
-    std::map<std::string, MiniValue> variables;
+    VariableSnapshot variables;
     std::optional<std::string> scene_id;
+    std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource();
+    std::shared_ptr<ElementStore> element_store;
+    ContextObserver* observer = nullptr;
+    std::shared_ptr<WriteLog> write_log;
 };
 
 /**
@@ -155,9 +331,30 @@ public:
     
     /**
      * @brief Validate parameters
+     *
+     * Checks that required parameters are present and that values match
+     * their declared type; null never matches a typed parameter.
      */
     virtual CommandResult validate_parameters(
-        const std::map<std::string, MiniValue>& params) const;
+        const std::map<std::string, MiniValue>& params) const {
+        for (const Parameter& param : get_parameters()) {
+            auto it = params.find(param.name);
+            if (it == params.end()) {
+                if (param.required) {
+                    return CommandResult(false, "Missing required parameter: " + param.name);
+                }
+                continue;
+            }
+            bool matches = param.type == "number"   ? std::holds_alternative<double>(it->second)
+                           : param.type == "string" ? std::holds_alternative<std::string>(it->second)
+                           : param.type == "bool"   ? std::holds_alternative<bool>(it->second)
+                                                    : true;
+            if (!matches) {
+                return CommandResult(false, "Type mismatch for parameter: " + param.name);
+            }
+        }
+        return CommandResult(true);
+    }
 };
 
 /**
@@ -183,7 +380,8 @@ public:
         Minus,
         Multiply,
         Divide,
-        Keyword
+        Keyword,
+        Range  // ".."
     };
     
     struct Token {
@@ -215,6 +413,7 @@ public:
      */
     struct ParsedCommand {
         std::string command_name;
+        SymbolId command_id = invalid_symbol;  ///< Interned command_name
         std::map<std::string, MiniValue> parameters;
         bool valid = false;
     };
@@ -255,16 +454,23 @@ public:
      * @brief Register a command
      */
     void register_command(std::shared_ptr<SceneCommand> command) {
-        commands[command->get_name()] = command;
+        commands.insert_or_assign(intern(command->get_name()), command);
     }
     
     /**
      * @brief Get a command by name
      */
     std::shared_ptr<SceneCommand> get_command(const std::string& name) const {
-        auto it = commands.find(name);
-        if (it != commands.end()) {
-            return it->second;
+        auto id = SymbolTable::global().find(name);
+        if (id) {
+            return get_command(*id);
+        }
+        return nullptr;
+    }
+    
+    std::shared_ptr<SceneCommand> get_command(SymbolId name) const {
+        if (const auto* command = commands.find(name)) {
+            return *command;
         }
         return nullptr;
     }
@@ -273,7 +479,8 @@ public:
      * @brief Check if a command exists
      */
     bool has_command(const std::string& name) const {
-        return commands.find(name) != commands.end();
+        auto id = SymbolTable::global().find(name);
+        return id && commands.contains(*id);
     }
     
     /**
@@ -281,9 +488,10 @@ public:
      */
     std::vector<std::string> get_all_commands() const {
         std::vector<std::string> names;
-        for (const auto& pair : commands) {
-            names.push_back(pair.first);
-        }
+        commands.for_each([&](SymbolId id, const auto&) {
+            names.emplace_back(SymbolTable::global().name(id));
+        });
+        std::sort(names.begin(), names.end());
         return names;
     }
     
@@ -295,7 +503,7 @@ public:
     }
 
 private:
-    std::map<std::string, std::shared_ptr<SceneCommand>> commands;
+    SymbolMap<std::shared_ptr<SceneCommand>> commands;
 };
 
 /**
@@ -372,128 +580,90 @@ public:
      * @brief Check if value matches expected type
      */
     static bool matches_type(const MiniValue& value, const std::string& type);
+    
+    /**
+     * @brief Overloads for the NaN-boxed Value (defined in value.hpp)
+     */
+    static std::string to_string(Value value);
+    static std::optional<double> to_number(Value value);
+    static std::optional<bool> to_bool(Value value);
+    static std::string get_type_name(Value value);
+    static bool matches_type(Value value, const std::string& type);
+
+    /**
+     * @brief Create a Value; from_string_value interns the text
+     * (defined in value.hpp)
+     */
+    static Value from_string_value(std::string_view value);
+    static Value from_number_value(double value);
+    static Value from_bool_value(bool value);
 };
 
-/**
- * @brief Built-in scene commands
- */
-namespace builtin_commands {
+// Numbers print in their shortest round-tripping form ("2", "1.5"), and
+// strings convert to numbers and bools only when the whole text is a
+// literal ("-2.5", "true").
 
-/**
- * @brief Command to create a new scene element
- */
-class CreateElementCommand : public SceneCommand {
-public:
-    std::string get_name() const override { return "create_element"; }
-    
-    std::string get_description() const override {
-        return "Create a new scene element";
-    }
-    
-    std::vector<Parameter> get_parameters() const override {
-        return {
-            {"type", "string", true, std::monostate(), "Element type"},
-            {"name", "string", true, std::monostate(), "Element name"},
-            {"x", "number", false, 0.0, "X coordinate"},
-            {"y", "number", false, 0.0, "Y coordinate"}
-        };
+inline std::string ValueConverter::to_string(const MiniValue& value) {
+    switch (value.index()) {
+        case 1: {
+            char text[32];
+            auto result = std::to_chars(text, text + sizeof(text), std::get<double>(value));
+            return std::string(text, result.ptr);
+        }
+        case 2: return std::get<std::string>(value);
+        case 3: return std::get<bool>(value) ? "true" : "false";
+        default: return "null";
     }
-    
-    CommandResult execute(const std::map<std::string, MiniValue>& params,
-                         CommandContext& context) override;
-};
+}
 
-/**
- * @brief Command to delete a scene element
- */
-class DeleteElementCommand : public SceneCommand {
-public:
-    std::string get_name() const override { return "delete_element"; }
-    
-    std::string get_description() const override {
-        return "Delete a scene element";
-    }
-    
-    std::vector<Parameter> get_parameters() const override {
-        return {
-            {"id", "string", true, std::monostate(), "Element ID"}
-        };
+inline std::optional<double> ValueConverter::to_number(const MiniValue& value) {
+    switch (value.index()) {
+        case 1: return std::get<double>(value);
+        case 2: {
+            std::string_view text = std::get<std::string>(value);
+            bool negative = !text.empty() && text.front() == '-';
+            std::optional<double> number = parse_number(negative ? text.substr(1) : text);
+            if (number && negative) {
+                *number = -*number;
+            }
+            return number;
+        }
+        case 3: return std::get<bool>(value) ? 1.0 : 0.0;
+        default: return std::nullopt;
     }
-    
-    CommandResult execute(const std::map<std::string, MiniValue>& params,
-                         CommandContext& context) override;
-};
+}
 
-/**
- * @brief Command to modify element properties
- */
-class SetPropertyCommand : public SceneCommand {
-public:
-    std::string get_name() const override { return "set_property"; }
-    
-    std::string get_description() const override {
-        return "Set a property of a scene element";
-    }
-    
-    std::vector<Parameter> get_parameters() const override {
-        return {
-            {"id", "string", true, std::monostate(), "Element ID"},
-            {"property", "string", true, std::monostate(), "Property name"},
-            {"value", "any", true, std::monostate(), "Property value"}
-        };
+inline std::optional<bool> ValueConverter::to_bool(const MiniValue& value) {
+    switch (value.index()) {
+        case 1: return std::get<double>(value) != 0.0;
+        case 2: {
+            const std::string& text = std::get<std::string>(value);
+            if (text == "true") return true;
+            if (text == "false") return false;
+            return std::nullopt;
+        }
+        case 3: return std::get<bool>(value);
+        default: return std::nullopt;
     }
-    
-    CommandResult execute(const std::map<std::string, MiniValue>& params,
-                         CommandContext& context) override;
-};
+}
 
-/**
- * @brief Command to query element properties
- */
-class GetPropertyCommand : public SceneCommand {
-public:
-    std::string get_name() const override { return "get_property"; }
-    
-    std::string get_description() const override {
-        return "Get a property of a scene element";
-    }
-    
-    std::vector<Parameter> get_parameters() const override {
-        return {
-            {"id", "string", true, std::monostate(), "Element ID"},
-            {"property", "string", true, std::monostate(), "Property name"}
-        };
-    }
-    
-    CommandResult execute(const std::map<std::string, MiniValue>& params,
-                         CommandContext& context) override;
-};
+inline MiniValue ValueConverter::from_string(const std::string& value) { return value; }
 
-/**
- * @brief Command to apply a transformation
- */
-class TransformCommand : public SceneCommand {
-public:
-    std::string get_name() const override { return "transform"; }
-    
-    std::string get_description() const override {
-        return "Apply transformation to an element";
-    }
-    
-    std::vector<Parameter> get_parameters() const override {
-        return {
-            {"id", "string", true, std::monostate(), "Element ID"},
-            {"operation", "string", true, std::monostate(), "Transform operation (move, rotate, scale)"},
-            {"x", "number", false, 0.0, "X parameter"},
-            {"y", "number", false, 0.0, "Y parameter"},
-            {"z", "number", false, 0.0, "Z parameter"}
-        };
+inline MiniValue ValueConverter::from_number(double value) { return value; }
+
+inline MiniValue ValueConverter::from_bool(bool value) { return value; }
+
+inline std::string ValueConverter::get_type_name(const MiniValue& value) {
+    switch (value.index()) {
+        case 1: return "number";
+        case 2: return "string";
+        case 3: return "bool";
+        default: return "null";
     }
-    
-    CommandResult execute(const std::map<std::string, MiniValue>& params,
-                         CommandContext& context) override;
-};
+}
 
-}  // namespace builtin_commands
+inline bool ValueConverter::matches_type(const MiniValue& value, const std::string& type) {
+    return type == "any" || type == get_type_name(value);
+}
 
 }  // namespace krayon::mini
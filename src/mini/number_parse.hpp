@@ -0,0 +1,97 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace krayon::mini {
+
+/**
+ * @file number_parse.hpp
+ * @brief Allocation-free number literal parsing for the mini language
+ *
+ * Literals are parsed directly from the source bytes. Short literals take
+ * the exact fast path (mantissa fits in 53 bits and the power of ten is
+ * exactly representable, so a single multiply or divide rounds correctly);
+ * everything else goes through std::from_chars, which is correctly rounded.
+ */
+
+namespace detail {
+
+inline constexpr double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * @brief Clinger fast path for plain decimal literals
+ *
+ * Handles [digits][.digits] without exponent. Returns nullopt when the
+ * literal is outside the exactly-representable range.
+ */
+inline std::optional<double> parse_number_fast(std::string_view text) {
+    constexpr uint64_t max_exact_mantissa = uint64_t{1} << 53;
+
+    uint64_t mantissa = 0;
+    int fraction_digits = 0;
+    int digits = 0;
+    bool seen_dot = false;
+
+    for (char c : text) {
+        if (c >= '0' && c <= '9') {
+            if (++digits > 19) {
+                return std::nullopt;
+            }
+            mantissa = mantissa * 10 + static_cast<uint64_t>(c - '0');
+            fraction_digits += seen_dot;
+        } else if (c == '.' && !seen_dot) {
+            seen_dot = true;
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    if (digits == 0 || mantissa > max_exact_mantissa || fraction_digits > 22) {
+        return std::nullopt;
+    }
+    double value = static_cast<double>(mantissa);
+    return fraction_digits == 0 ? value : value / exact_powers_of_ten[fraction_digits];
+}
+
+}  // namespace detail
+
+/**
+ * @brief Parse an unsigned number literal as produced by the tokenizer
+ *
+ * Accepts digits with an optional fraction and exponent, including a leading
+ * '.' (".5"). Returns nullopt if the whole text is not a valid literal.
+ * Signs are not part of number tokens; unary minus is applied by the parser.
+ */
+inline std::optional<double> parse_number(std::string_view text) {
+    if (auto fast = detail::parse_number_fast(text)) {
+        return fast;
+    }
+    if (text.empty() || text.front() == '+' || text.front() == '-') {
+        return std::nullopt;
+    }
+
+    double value = 0.0;
+    const char* first = text.data();
+    const char* last = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(first, last, value, std::chars_format::general);
+    if (ec == std::errc::result_out_of_range) {
+        // from_chars leaves value untouched on overflow/underflow; keep the
+        // strtod result (inf or a denormal/zero) for such rare literals.
+        return std::strtod(std::string(text).c_str(), nullptr);
+    }
+    if (ec != std::errc() || ptr != last) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+}  // namespace krayon::mini
@@ -0,0 +1,371 @@
+#pragma once
+
+#include "script_compiler.hpp"
+#include "../core/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file parallel_executor.hpp
+ * @brief Dependency-aware concurrent execution of compiled scripts
+ *
+ * Each command's read/write set (element ids and context variables) is
+ * derived from its bound arguments. Commands are ordered by a DAG with an
+ * edge wherever two commands conflict, and independent commands run
+ * concurrently on a thread pool. Results are returned in source order,
+ * and every conflicting pair executes in source order, so the outcome
+ * matches sequential execution.
+ *
+ * Element commands are keyed by element id. Creating or deleting an
+ * element changes the rows of every column, so those writes conflict with
+ * every other element access and run one at a time in source order, which
+ * also keeps row order deterministic. set_property and transform on a
+ * literal id only change values in that element's row: they conflict with
+ * other accesses to the same id and otherwise run concurrently. The
+ * property columns they write are sized before the run and again after
+ * each create or delete, so they never grow while rows are written (see
+ * ElementStore). Writes to an indexed property, or after a barrier that
+ * may have added an index, update shared index state and fall back to
+ * whole-store writes.
+ *
+ * Each command runs on a private copy of the context, taken once its
+ * dependencies have finished, so its variable reads see a stable map. The
+ * variables it declares as written are merged back into the shared context
+ * before its dependents start. Copies use the default memory resource, as
+ * a batch arena is not thread-safe. Commands whose access cannot be
+ * determined act as barriers and run alone on the shared context.
+ */
+
+/**
+ * @brief Keys a command reads and writes
+ */
+struct AccessSet {
+    std::vector<std::string> element_reads;  ///< Element ids
+    std::vector<std::string> element_writes;
+    std::vector<SymbolId> variable_reads;
+    std::vector<SymbolId> variable_writes;
+    std::vector<SymbolId> property_writes;  ///< Columns changed by row writes
+    bool row_writes = false;  ///< Element writes only change values of existing rows
+    bool barrier = false;     ///< Conflicts with everything
+
+    void clear() {
+        element_reads.clear();
+        element_writes.clear();
+        variable_reads.clear();
+        variable_writes.clear();
+        property_writes.clear();
+        row_writes = false;
+        barrier = false;
+    }
+};
+
+/**
+ * @brief Optional interface for commands that declare their access set
+ */
+class AccessAware {
+public:
+    virtual ~AccessAware() = default;
+
+    virtual void describe_access(const BoundArguments& args, AccessSet& access) const = 0;
+};
+
+/**
+ * @brief Derive the access set of a compiled command
+ *
+ * AccessAware commands describe themselves. Builtin commands touch exactly
+ * the element named by their key parameter ("name" for create_element,
+ * "id" otherwise; get_property only reads); transform, and set_property
+ * with a literal property, are row writes. Anything else, including a
+ * loop or a builtin whose key is computed at execution, is a barrier.
+ * Variables read by argument expressions are added to the reads.
+ */
+inline void describe_access(const CompiledCommand& compiled, AccessSet& access) {
+    access.clear();
+    if (compiled.loop) {
+        access.barrier = true;
+        return;
+    }
+    if (compiled.program) {
+        auto variables = compiled.program->get_variables();
+        access.variable_reads.assign(variables.begin(), variables.end());
+    }
+    if (const auto* aware = dynamic_cast<const AccessAware*>(compiled.command)) {
+        aware->describe_access(compiled.args, access);
+        return;
+    }
+
+    int builtin = builtin_commands::builtin_index_of(*compiled.command);
+    if (builtin < 0) {
+        access.barrier = true;
+        return;
+    }
+    std::string_view name = builtin_command_names[static_cast<size_t>(builtin)];
+
+    auto text_at = [&](std::string_view parameter) -> const std::string* {
+        int slot = compiled.schema->slot_of(intern(parameter));
+        const MiniValue* value =
+            slot >= 0 ? compiled.args.get(static_cast<size_t>(slot)) : nullptr;
+        return value ? std::get_if<std::string>(value) : nullptr;
+    };
+    const std::string* element = text_at(name == "create_element" ? "name" : "id");
+    if (!element) {
+        access.barrier = true;
+        return;
+    }
+    if (name == "get_property") {
+        access.element_reads.push_back(*element);
+        return;
+    }
+    access.element_writes.push_back(*element);
+    if (name == "transform") {
+        access.row_writes = true;
+    } else if (name == "set_property") {
+        if (const std::string* property = text_at("property")) {
+            access.row_writes = true;
+            access.property_writes.push_back(intern(*property));
+        }
+    }
+}
+
+/**
+ * @brief Command DAG: edges point from a command to those that must wait for it
+ */
+struct DependencyGraph {
+    std::vector<std::vector<uint32_t>> successors;
+    std::vector<uint32_t> dependency_count;
+    std::vector<AccessSet> access;  ///< Per command, as used for the edges
+};
+
+/**
+ * @brief Build the conflict DAG for a compiled script
+ * @param store Store the script will run on; without one, row writes are
+ *              scheduled as whole-store writes
+ */
+inline DependencyGraph build_dependency_graph(const CompiledScript& script,
+                                              const ElementStore* store = nullptr) {
+    struct KeyState {
+        int64_t last_writer = -1;
+        std::vector<uint32_t> readers;  ///< Readers since last_writer
+    };
+
+    size_t count = script.commands.size();
+    DependencyGraph graph;
+    graph.successors.resize(count);
+    graph.dependency_count.assign(count, 0);
+    graph.access.resize(count);
+
+    std::unordered_map<SymbolId, KeyState> variables;
+    std::unordered_map<std::string_view, KeyState> elements;  ///< Views into graph.access
+    KeyState whole_store;
+    std::vector<uint32_t> since_barrier;
+    int64_t last_barrier = -1;
+    std::vector<uint32_t> deps;
+
+    auto add_edges = [&](uint32_t node) {
+        deps.erase(std::remove(deps.begin(), deps.end(), node), deps.end());
+        std::sort(deps.begin(), deps.end());
+        deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+        for (uint32_t dep : deps) {
+            graph.successors[dep].push_back(node);
+        }
+        graph.dependency_count[node] = static_cast<uint32_t>(deps.size());
+    };
+
+    for (uint32_t i = 0; i < count; ++i) {
+        AccessSet& access = graph.access[i];
+        describe_access(script.commands[i], access);
+        deps.clear();
+
+        if (access.barrier) {
+            deps = since_barrier;
+            if (last_barrier >= 0) {
+                deps.push_back(static_cast<uint32_t>(last_barrier));
+            }
+            add_edges(i);
+            variables.clear();
+            elements.clear();
+            whole_store = KeyState();
+            since_barrier.clear();
+            last_barrier = i;
+            continue;
+        }
+
+        if (last_barrier >= 0) {
+            deps.push_back(static_cast<uint32_t>(last_barrier));
+        }
+        auto read = [&](KeyState& state) {
+            if (state.last_writer >= 0) {
+                deps.push_back(static_cast<uint32_t>(state.last_writer));
+            }
+            state.readers.push_back(i);
+        };
+        auto write = [&](KeyState& state) {
+            if (state.last_writer >= 0) {
+                deps.push_back(static_cast<uint32_t>(state.last_writer));
+            }
+            deps.insert(deps.end(), state.readers.begin(), state.readers.end());
+            state.readers.clear();
+            state.last_writer = i;
+        };
+
+        // A barrier may have indexed a property, so only writes before the
+        // first one can be sure of touching no index.
+        if (access.row_writes &&
+            (!store || last_barrier >= 0 ||
+             std::any_of(access.property_writes.begin(), access.property_writes.end(),
+                         [&](SymbolId property) { return store->is_indexed(property); }))) {
+            access.row_writes = false;
+        }
+        // Creates and deletes write the whole store; other element
+        // accesses read it and are ordered per id (see the file comment).
+        if (!access.element_writes.empty() && !access.row_writes) {
+            write(whole_store);
+        } else if (!access.element_reads.empty() || !access.element_writes.empty()) {
+            read(whole_store);
+            for (const std::string& id : access.element_reads) read(elements[id]);
+            for (const std::string& id : access.element_writes) write(elements[id]);
+        }
+        for (SymbolId id : access.variable_reads) read(variables[id]);
+        for (SymbolId id : access.variable_writes) write(variables[id]);
+
+        add_edges(i);
+        since_barrier.push_back(i);
+    }
+    return graph;
+}
+
+/**
+ * @brief Execute a compiled script concurrently, respecting dependencies
+ *
+ * Blocks until every command has run. If commands throw, all
+ * non-dependent commands still complete and the exception of the earliest
+ * throwing command is rethrown. A context with an observer runs the script
+ * sequentially, since observers are not required to be thread-safe.
+ */
+inline std::vector<CommandResult> execute_parallel(const CompiledScript& script,
+                                                   CommandContext& context,
+                                                   core::ThreadPool& pool) {
+    if (context.get_observer()) {
+        return execute_script(script, context);
+    }
+    size_t count = script.commands.size();
+    std::vector<CommandResult> results(count);
+    if (count == 0) {
+        return results;
+    }
+
+    const std::shared_ptr<ElementStore>& store = context.get_element_store();
+    DependencyGraph graph = build_dependency_graph(script, store.get());
+    auto remaining = std::make_unique<std::atomic<uint32_t>[]>(count);
+    for (size_t i = 0; i < count; ++i) {
+        remaining[i].store(graph.dependency_count[i], std::memory_order_relaxed);
+    }
+    std::vector<std::exception_ptr> errors(count);
+    std::mutex context_mutex;  ///< Guards the shared context's variables
+    std::mutex done_mutex;
+    std::condition_variable done_signal;
+    size_t pending = count;
+
+    // Columns of row writes are sized while no element command runs, so
+    // those writes never grow them.
+    std::vector<SymbolId> columns;
+    for (const AccessSet& access : graph.access) {
+        if (access.row_writes) {
+            columns.insert(columns.end(), access.property_writes.begin(),
+                           access.property_writes.end());
+        }
+    }
+    std::sort(columns.begin(), columns.end());
+    columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+    auto size_columns = [&] {
+        if (store) {
+            for (SymbolId property : columns) {
+                store->property_column(property);
+            }
+        }
+    };
+    size_columns();
+
+    // Runs a command on a private copy of the context and merges the
+    // variables it declared as written back into the shared one.
+    auto run_isolated = [&](uint32_t node) {
+        const AccessSet& access = graph.access[node];
+        std::optional<CommandContext> local;
+        {
+            std::lock_guard lock(context_mutex);
+            local.emplace(context);
+        }
+        local->set_memory_resource(nullptr);
+        results[node] = execute_compiled(script.commands[node], *local);
+        if (access.variable_writes.empty()) {
+            return;
+        }
+        std::lock_guard lock(context_mutex);
+        for (SymbolId name : access.variable_writes) {
+            if (const MiniValue* value = local->find_variable(name)) {
+                context.set_variable(name, *value);
+            } else {
+                context.remove_variable(name);
+            }
+        }
+    };
+
+    std::function<void(uint32_t)> run = [&](uint32_t node) {
+        try {
+            if (graph.access[node].barrier) {
+                // Nothing else runs while a barrier does.
+                results[node] = execute_compiled(script.commands[node], context);
+            } else {
+                run_isolated(node);
+            }
+        } catch (...) {
+            errors[node] = std::current_exception();
+        }
+        const AccessSet& access = graph.access[node];
+        if (access.barrier || (!access.element_writes.empty() && !access.row_writes)) {
+            size_columns();
+        }
+        for (uint32_t next : graph.successors[node]) {
+            if (remaining[next].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                pool.submit([&run, next] { run(next); });
+            }
+        }
+        std::lock_guard lock(done_mutex);
+        if (--pending == 0) {
+            done_signal.notify_all();
+        }
+    };
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (graph.dependency_count[i] == 0) {
+            pool.submit([&run, i] { run(i); });
+        }
+    }
+    {
+        std::unique_lock lock(done_mutex);
+        done_signal.wait(lock, [&] { return pending == 0; });
+    }
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return results;
+}
+
+}  // namespace krayon::mini
@@ -0,0 +1,311 @@
+#pragma once
+
+#include "symbol_table.hpp"
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file persistent_map.hpp
+ * @brief Persistent (immutable, structurally shared) map keyed by SymbolId
+ *
+ * A hash array mapped trie over the bits of the symbol id, five bits per
+ * level. Because ids are dense and unique, the id itself is the hash and
+ * there are no collisions. Levels are taken from the high bits down and
+ * the root only spans the largest id stored, so ids interned together
+ * share a path, and a key that is alone in its subtree sits in the
+ * highest node with a free slot. Copying a map copies one pointer; a
+ * write copies only the shared nodes on the path to the key, so snapshots,
+ * forks and rollbacks are O(1) and writes O(log32 n). Nodes and values
+ * that no other map shares are updated in place, so repeated writes to a
+ * map with no live snapshot do not allocate. A shared node is never
+ * modified, so a snapshot may be read from other threads while the
+ * original keeps changing.
+ */
+
+namespace detail {
+
+/**
+ * @brief Reference-counted pointer that knows when it is the only owner
+ *
+ * std::shared_ptr::use_count() is a relaxed load, so acting on a count of
+ * one would race with another owner's last reads. unique() loads the
+ * count with acquire ordering instead, pairing with the release in the
+ * other owner's decrement.
+ */
+template<typename U>
+class CountedPtr {
+public:
+    CountedPtr() = default;
+    CountedPtr(std::nullptr_t) {}
+
+    template<typename... Args>
+    static CountedPtr make(Args&&... args) {
+        CountedPtr ptr;
+        ptr.block = new Block(std::forward<Args>(args)...);
+        return ptr;
+    }
+
+    CountedPtr(const CountedPtr& other) : block(other.block) {
+        if (block) {
+            block->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    CountedPtr(CountedPtr&& other) noexcept : block(std::exchange(other.block, nullptr)) {}
+
+    CountedPtr& operator=(CountedPtr other) noexcept {
+        std::swap(block, other.block);
+        return *this;
+    }
+
+    ~CountedPtr() {
+        if (block && block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete block;
+        }
+    }
+
+    U* get() const { return block ? &block->object : nullptr; }
+    U& operator*() const { return block->object; }
+    U* operator->() const { return &block->object; }
+    explicit operator bool() const { return block != nullptr; }
+    bool operator==(const CountedPtr& other) const { return block == other.block; }
+
+    bool unique() const { return block && block->refs.load(std::memory_order_acquire) == 1; }
+
+private:
+    struct Block {
+        template<typename... Args>
+        explicit Block(Args&&... args) : object(std::forward<Args>(args)...) {}
+
+        std::atomic<uint32_t> refs{1};
+        U object;
+    };
+
+    Block* block = nullptr;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Persistent map keyed by SymbolId
+ */
+template<typename T>
+class PersistentSymbolMap {
+public:
+    PersistentSymbolMap() = default;
+
+    /**
+     * @brief Find the value for a key, or nullptr
+     */
+    const T* find(SymbolId key) const {
+        if (!covers(key)) {
+            return nullptr;
+        }
+        const Node* node = root.get();
+        for (unsigned shift = root_shift; node; shift -= bits_per_level) {
+            uint32_t bit = bit_of(key, shift);
+            if (!(node->bitmap & bit)) {
+                return nullptr;
+            }
+            const Entry& entry = node->entries[node->index_of(bit)];
+            if (!entry.child) {
+                return entry.key == key ? entry.value.get() : nullptr;
+            }
+            node = entry.child.get();
+        }
+        return nullptr;
+    }
+
+    bool contains(SymbolId key) const { return find(key) != nullptr; }
+
+    /**
+     * @brief Insert or overwrite the value for a key
+     */
+    void insert_or_assign(SymbolId key, T value) {
+        while (!covers(key)) {
+            if (root) {
+                auto wrapper = NodePtr::make();
+                wrapper->bitmap = 1;
+                wrapper->entries.push_back(Entry{invalid_symbol, nullptr, std::move(root)});
+                root = std::move(wrapper);
+            }
+            root_shift += bits_per_level;
+        }
+        bool added = false;
+        insert(root, root_shift, key, value, added);
+        count += added;
+    }
+
+    /**
+     * @brief Remove a key; returns whether it was present
+     */
+    bool erase(SymbolId key) {
+        bool removed = false;
+        if (!covers(key)) {
+            return false;
+        }
+        NodePtr replaced = erase(root, root_shift, key, removed);
+        if (removed) {
+            root = std::move(replaced);
+            --count;
+        }
+        return removed;
+    }
+
+    void clear() {
+        root = nullptr;
+        root_shift = 0;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    /**
+     * @brief Do both maps share the same root (and so the same contents)?
+     */
+    bool shares_root_with(const PersistentSymbolMap& other) const { return root == other.root; }
+
+    /**
+     * @brief Visit every (key, value) pair in unspecified order
+     */
+    template<typename Fn>
+    void for_each(Fn&& fn) const {
+        visit(root.get(), fn);
+    }
+
+private:
+    static constexpr unsigned bits_per_level = 5;
+
+    struct Node;
+    using NodePtr = detail::CountedPtr<Node>;
+
+    /**
+     * @brief A leaf (value set) or a subtree (child set)
+     */
+    struct Entry {
+        SymbolId key = invalid_symbol;
+        detail::CountedPtr<T> value;
+        NodePtr child;
+    };
+
+    struct Node {
+        uint32_t bitmap = 0;
+        std::vector<Entry> entries;  ///< One per set bit, in bit order
+
+        size_t index_of(uint32_t bit) const {
+            return static_cast<size_t>(std::popcount(bitmap & (bit - 1)));
+        }
+    };
+
+    NodePtr root;
+    unsigned root_shift = 0;  ///< Shift of the bits indexing the root
+    size_t count = 0;
+
+    bool covers(SymbolId key) const {
+        return root_shift + bits_per_level >= 32 || (key >> (root_shift + bits_per_level)) == 0;
+    }
+
+    static uint32_t bit_of(SymbolId key, unsigned shift) {
+        return uint32_t{1} << ((key >> shift) & ((1u << bits_per_level) - 1));
+    }
+
+    /**
+     * @brief Store value under key in the subtree at node, copying the
+     * node first if another map shares it
+     */
+    static void insert(NodePtr& node, unsigned shift, SymbolId key, T& value, bool& added) {
+        if (!node) {
+            node = NodePtr::make();
+        } else if (!node.unique()) {
+            node = NodePtr::make(*node);
+        }
+        uint32_t bit = bit_of(key, shift);
+        size_t index = node->index_of(bit);
+        if (!(node->bitmap & bit)) {
+            node->entries.insert(node->entries.begin() + static_cast<std::ptrdiff_t>(index),
+                                 Entry{key, detail::CountedPtr<T>::make(std::move(value)), nullptr});
+            node->bitmap |= bit;
+            added = true;
+            return;
+        }
+        Entry& entry = node->entries[index];
+        if (entry.child) {
+            insert(entry.child, shift - bits_per_level, key, value, added);
+        } else if (entry.key == key) {
+            if (entry.value.unique()) {
+                *entry.value = std::move(value);
+            } else {
+                entry.value = detail::CountedPtr<T>::make(std::move(value));
+            }
+        } else {
+            // Two keys share this slot: push both one level down. Distinct
+            // ids differ in some lower bit, so shift is not yet 0.
+            auto child = NodePtr::make();
+            child->bitmap = bit_of(entry.key, shift - bits_per_level);
+            child->entries.push_back(std::move(entry));
+            entry = Entry{invalid_symbol, nullptr, std::move(child)};
+            insert(entry.child, shift - bits_per_level, key, value, added);
+        }
+    }
+
+    static NodePtr erase(const NodePtr& node, unsigned shift, SymbolId key, bool& removed) {
+        if (!node) {
+            return node;
+        }
+        uint32_t bit = bit_of(key, shift);
+        if (!(node->bitmap & bit)) {
+            return node;
+        }
+        size_t index = node->index_of(bit);
+        const Entry& entry = node->entries[index];
+        NodePtr child;
+        if (entry.child) {
+            child = erase(entry.child, shift - bits_per_level, key, removed);
+        } else {
+            removed = entry.key == key;
+        }
+        if (!removed) {
+            return node;
+        }
+
+        auto copy = NodePtr::make(*node);
+        auto position = copy->entries.begin() + static_cast<std::ptrdiff_t>(index);
+        if (child && child->entries.size() == 1 && !child->entries[0].child) {
+            // Keep the trie canonical: a lone leaf moves up into its parent.
+            *position = child->entries[0];
+        } else if (child) {
+            position->child = std::move(child);
+        } else {
+            copy->entries.erase(position);
+            copy->bitmap &= ~bit;
+            if (copy->entries.empty()) {
+                return nullptr;
+            }
+        }
+        return copy;
+    }
+
+    template<typename Fn>
+    static void visit(const Node* node, Fn& fn) {
+        if (!node) {
+            return;
+        }
+        for (const Entry& entry : node->entries) {
+            if (entry.child) {
+                visit(entry.child.get(), fn);
+            } else {
+                fn(entry.key, *entry.value);
+            }
+        }
+    }
+};
+
+}  // namespace krayon::mini
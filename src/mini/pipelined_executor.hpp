@@ -0,0 +1,118 @@
+#pragma once
+
+#include "script_stream.hpp"
+#include "../core/spsc_queue.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <thread>
+
+namespace krayon::mini {
+
+/**
+ * @file pipelined_executor.hpp
+ * @brief Two-stage parse/execute pipeline for streamed scripts
+ *
+ * A producer thread pulls compiled commands from a ScriptStream into a
+ * bounded lock-free SPSC ring; the calling thread pops and executes them
+ * against the CommandContext. The ring's capacity provides back-pressure,
+ * so a slow executor throttles parsing instead of buffering the script.
+ */
+
+/**
+ * @brief Per-stage counters for one pipelined run
+ */
+struct PipelineStats {
+    size_t commands_parsed = 0;
+    size_t commands_executed = 0;
+    double parse_seconds = 0.0;    ///< Parser busy time (excludes waits on a full ring)
+    double execute_seconds = 0.0;  ///< Executor busy time (excludes waits on an empty ring)
+    size_t parser_waits = 0;       ///< Times the parser blocked on a full ring
+    size_t executor_waits = 0;     ///< Times the executor blocked on an empty ring
+
+    double parse_throughput() const {
+        return parse_seconds > 0.0 ? commands_parsed / parse_seconds : 0.0;
+    }
+
+    double execute_throughput() const {
+        return execute_seconds > 0.0 ? commands_executed / execute_seconds : 0.0;
+    }
+};
+
+/**
+ * @brief Runs parsing and execution of a ScriptStream on separate threads
+ */
+class PipelinedExecutor {
+public:
+    explicit PipelinedExecutor(size_t queue_capacity = 1024) : capacity(queue_capacity) {}
+
+    /**
+     * @brief Parse on a worker thread and execute on the calling thread
+     * @param on_result Called with each result, in source order
+     * @return false if parsing failed (the stream holds the error)
+     */
+    template<typename ResultFn>
+    bool run(ScriptStream& stream, CommandContext& context, ResultFn&& on_result) {
+        using Clock = std::chrono::steady_clock;
+
+        core::SpscQueue<CompiledCommand> queue(capacity);
+        counters = PipelineStats{};
+        std::exception_ptr parse_error;
+
+        std::thread parser([&] {
+            Clock::duration busy{};
+            try {
+                CompiledCommand compiled;
+                auto start = Clock::now();
+                while (stream.next(compiled)) {
+                    ++counters.commands_parsed;
+                    busy += Clock::now() - start;
+                    if (!queue.push(std::move(compiled))) {
+                        break;
+                    }
+                    start = Clock::now();
+                }
+            } catch (...) {
+                parse_error = std::current_exception();
+            }
+            counters.parse_seconds = std::chrono::duration<double>(busy).count();
+            counters.parser_waits = queue.get_producer_waits();
+            queue.close();
+        });
+
+        Clock::duration busy{};
+        try {
+            CompiledCommand compiled;
+            while (queue.pop(compiled)) {
+                auto start = Clock::now();
+                on_result(execute_compiled(compiled, context));
+                busy += Clock::now() - start;
+                ++counters.commands_executed;
+            }
+        } catch (...) {
+            queue.cancel();
+            parser.join();
+            throw;
+        }
+        parser.join();
+
+        counters.execute_seconds = std::chrono::duration<double>(busy).count();
+        counters.executor_waits = queue.get_consumer_waits();
+        if (parse_error) {
+            std::rethrow_exception(parse_error);
+        }
+        return !stream.failed();
+    }
+
+    /**
+     * @brief Counters from the most recent run
+     */
+    const PipelineStats& stats() const { return counters; }
+
+private:
+    size_t capacity;
+    PipelineStats counters;
+};
+
+}  // namespace krayon::mini
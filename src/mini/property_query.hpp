@@ -0,0 +1,209 @@
+#pragma once
+
+#include "builtin_commands.hpp"
+#include "command_schema.hpp"
+#include "element_store.hpp"
+#include "value.hpp"
+
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file property_query.hpp
+ * @brief Commands that index and query element properties
+ *
+ * `index_property(property: "color", kind: "hash")` adds a secondary index
+ * to the context's ElementStore ("hash" for equality, "sorted" for numeric
+ * ranges). `query_elements` then finds elements by property value:
+ *
+ *     index_property(property: "color")
+ *     query_elements(property: "color", equals: "red")
+ *     query_elements(property: "mass", min: 1, max: 5, limit: 10)
+ *
+ * The result's return value lists the matching ids, comma-separated, in
+ * row order. A ',' or '\' inside an id is preceded by a backslash, so
+ * splitting on unescaped commas recovers every id. Queries on properties
+ * without the matching index still work by scanning the column. Neither
+ * command is a builtin; register them alongside the builtins to use them.
+ */
+
+namespace builtin_commands {
+
+/**
+ * @brief Command to add a secondary index on an element property
+ */
+class IndexPropertyCommand : public SceneCommand, public SlotCommand {
+public:
+    std::string get_name() const override { return "index_property"; }
+
+    std::string get_description() const override {
+        return "Index an element property for query_elements";
+    }
+
+    std::vector<Parameter> get_parameters() const override {
+        return {
+            {"property", "string", true, std::monostate(), "Property name"},
+            {"kind", "string", false, std::string("hash"), "hash or sorted"}
+        };
+    }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        return run(detail::find_param(params, "property"), detail::find_param(params, "kind"),
+                   context);
+    }
+
+    CommandResult execute_slots(const BoundArguments& args, CommandContext& context) override {
+        return run(args.get(0), args.get(1), context);
+    }
+
+    CommandResult validate_slots(const BoundArguments& args) const override {
+        const MiniValue* kind = args.get(1);
+        if (kind && std::holds_alternative<std::string>(*kind)) {
+            const std::string& name = std::get<std::string>(*kind);
+            if (name != "hash" && name != "sorted") {
+                return CommandResult(false, "Unknown index kind: " + name);
+            }
+        }
+        return CommandResult(true);
+    }
+
+private:
+    /**
+     * @param kind Index kind; "hash" when absent
+     */
+    static CommandResult run(const MiniValue* property, const MiniValue* kind,
+                             CommandContext& context) {
+        const std::string* name = detail::text_of(property);
+        if (!name) {
+            return detail::missing("property");
+        }
+        const std::string* kind_text = detail::text_of(kind);
+        if (kind && !kind_text) {
+            return CommandResult(false, "Parameter kind must be a string");
+        }
+        std::string_view kind_name = kind_text ? std::string_view(*kind_text) : "hash";
+        const auto& store = context.get_element_store();
+        if (!store) {
+            return CommandResult(false, "Indexes need an element store");
+        }
+        if (kind_name != "hash" && kind_name != "sorted") {
+            return CommandResult(false, "Unknown index kind: " + std::string(kind_name));
+        }
+        store->create_index(intern(*name), kind_name == "hash" ? ElementStore::IndexKind::Hash
+                                                               : ElementStore::IndexKind::Sorted);
+        return CommandResult(true);
+    }
+};
+
+/**
+ * @brief Command to find elements by property value
+ */
+class QueryElementsCommand : public SceneCommand, public SlotCommand {
+public:
+    std::string get_name() const override { return "query_elements"; }
+
+    std::string get_description() const override {
+        return "Find elements whose property equals a value or lies in a range";
+    }
+
+    std::vector<Parameter> get_parameters() const override {
+        return {
+            {"property", "string", true, std::monostate(), "Property name"},
+            {"equals", "any", false, std::monostate(), "Value to match"},
+            {"min", "number", false, std::monostate(), "Lowest value in range"},
+            {"max", "number", false, std::monostate(), "Highest value in range"},
+            {"limit", "number", false, std::monostate(), "Maximum number of ids returned"}
+        };
+    }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        auto get = [&](const char* name) { return detail::find_param(params, name); };
+        return run(get("property"), get("equals"), get("min"), get("max"), get("limit"),
+                   context);
+    }
+
+    CommandResult execute_slots(const BoundArguments& args, CommandContext& context) override {
+        return run(args.get(0), args.get(1), args.get(2), args.get(3), args.get(4), context);
+    }
+
+    CommandResult validate_slots(const BoundArguments& args) const override {
+        return check(args.get(1), args.get(2), args.get(3));
+    }
+
+private:
+    static CommandResult check(const MiniValue* equals, const MiniValue* min,
+                               const MiniValue* max) {
+        if (equals && (min || max)) {
+            return CommandResult(false, "Use either equals or min/max, not both");
+        }
+        if (!equals && !min && !max) {
+            return CommandResult(false, "Missing required parameter: equals");
+        }
+        return CommandResult(true);
+    }
+
+    static CommandResult run(const MiniValue* property, const MiniValue* equals,
+                             const MiniValue* min, const MiniValue* max, const MiniValue* limit,
+                             CommandContext& context) {
+        const std::string* name = detail::text_of(property);
+        if (!name) {
+            return detail::missing("property");
+        }
+        CommandResult checked = check(equals, min, max);
+        if (!checked.success) {
+            return checked;
+        }
+        for (auto [parameter, value] : {std::pair{"min", min}, std::pair{"max", max},
+                                        std::pair{"limit", limit}}) {
+            if (value && !std::holds_alternative<double>(*value)) {
+                return CommandResult(false, std::string("Parameter ") + parameter +
+                                                " must be a number");
+            }
+        }
+        const auto& store = context.get_element_store();
+        if (!store) {
+            return CommandResult(false, "Queries need an element store");
+        }
+
+        std::pmr::vector<ElementStore::Row> rows(context.get_memory_resource());
+        if (equals) {
+            store->rows_equal(intern(*name), Value::from_mini(*equals), rows);
+        } else {
+            store->rows_in_range(
+                intern(*name),
+                min ? std::get<double>(*min) : -std::numeric_limits<double>::infinity(),
+                max ? std::get<double>(*max) : std::numeric_limits<double>::infinity(), rows);
+        }
+        if (limit && std::get<double>(*limit) >= 0.0 &&
+            std::get<double>(*limit) < static_cast<double>(rows.size())) {
+            rows.resize(static_cast<size_t>(std::get<double>(*limit)));
+        }
+
+        std::string ids;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (i > 0) {
+                ids += ',';
+            }
+            for (char c : store->id_at(rows[i])) {
+                if (c == ',' || c == '\\') {
+                    ids += '\\';
+                }
+                ids += c;
+            }
+        }
+        return CommandResult(true, std::to_string(rows.size()) + " elements", ids);
+    }
+};
+
+}  // namespace builtin_commands
+
+}  // namespace krayon::mini
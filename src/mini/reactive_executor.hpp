@@ -0,0 +1,424 @@
+#pragma once
+
+#include "element_store.hpp"
+#include "parallel_executor.hpp"
+#include "script_compiler.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file reactive_executor.hpp
+ * @brief Incremental re-execution of a compiled script
+ *
+ * ReactiveExecutor runs a script once while recording, per command, which
+ * context variables and elements it reads and writes. Variables are
+ * recorded dynamically through a ContextObserver, so reads made inside
+ * command implementations count; elements come from describe_access(),
+ * plus whatever rows a command adds to the ElementStore. After the caller
+ * changes a variable or an element, update() re-executes only the
+ * commands affected by the change and everything downstream of them;
+ * every other command keeps its memoized result.
+ *
+ * Re-execution must behave like a full run. Each command sees the value
+ * its variables had at its position in the script: the value after the
+ * last earlier writer, memoized per command, or the value before the
+ * script. An element created by the script is removed and rebuilt, by
+ * re-running every command touching it, whenever any of those commands is
+ * affected; this needs the context's ElementStore, and elements that exist
+ * before the script are updated in place. Commands whose element access
+ * cannot be determined (barriers) re-run whenever anything before them
+ * does, and force everything after them.
+ */
+class ReactiveExecutor {
+public:
+    /**
+     * @param script Must outlive the executor
+     */
+    ReactiveExecutor(const CompiledScript& script, CommandContext& context)
+        : script(script), context(context), footprints(script.commands.size()),
+          outputs(script.commands.size()), results(script.commands.size()) {}
+
+    /**
+     * @brief Execute every command and record dependencies
+     */
+    const std::vector<CommandResult>& run() {
+        std::vector<char> all(script.commands.size(), 1);
+        execute(all);
+        changed_variables.clear();
+        changed_elements.clear();
+        return results;
+    }
+
+    /**
+     * @brief Change a variable; takes effect on the next update()
+     */
+    void set_variable(const std::string& name, const MiniValue& value) {
+        SymbolId id = intern(name);
+        context.set_variable(id, value);
+        // For a variable the script also writes, this is the value it
+        // starts from.
+        auto initial = initial_values.find(id);
+        if (initial != initial_values.end()) {
+            initial->second = value;
+        }
+        changed_variables.push_back(id);
+    }
+
+    /**
+     * @brief Report an element changed outside the script
+     *
+     * Commands using it re-run on the next update(). An element the
+     * script creates is rebuilt from the script, discarding the outside
+     * change.
+     */
+    void touch_element(std::string_view id) {
+        changed_elements.push_back(element_names.intern(id));
+    }
+
+    /**
+     * @brief Re-execute the commands affected by changes since the last run
+     * @return Number of commands executed
+     */
+    size_t update() {
+        size_t count = script.commands.size();
+        std::vector<char> dirty(count, 0);
+        for (SymbolId id : changed_variables) {
+            mark_all(dirty, variable_readers, id, 0);
+        }
+        bool element_changed = !changed_elements.empty();
+        for (SymbolId id : changed_elements) {
+            mark_all(dirty, element_users, id, 0);
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            if (footprints[i].barrier && element_changed) {
+                dirty[i] = 1;
+            }
+        }
+        changed_variables.clear();
+        changed_elements.clear();
+
+        std::vector<SymbolId> rebuilt = propagate(dirty);
+        if (const auto& store = context.get_element_store()) {
+            for (SymbolId id : rebuilt) {
+                store->remove(element_names.name(id));
+            }
+        }
+        return execute(dirty);
+    }
+
+    const std::vector<CommandResult>& get_results() const { return results; }
+
+    /**
+     * @brief Commands executed by the last run() or update()
+     */
+    size_t last_executed() const { return executed; }
+
+private:
+    /**
+     * @brief Variables by global symbol; elements by element_names symbol
+     */
+    struct Footprint {
+        std::vector<SymbolId> variable_reads;
+        std::vector<SymbolId> variable_writes;
+        std::vector<SymbolId> element_reads;
+        std::vector<SymbolId> element_writes;
+        std::vector<SymbolId> created;  ///< Elements added to the store
+        bool barrier = false;
+
+        bool operator==(const Footprint&) const = default;
+    };
+
+    /**
+     * @brief Collects the variables one command touches
+     */
+    struct Recorder : ContextObserver {
+        ReactiveExecutor* owner = nullptr;
+        Footprint* footprint = nullptr;
+
+        void on_variable_read(SymbolId name) override {
+            footprint->variable_reads.push_back(name);
+        }
+
+        void on_variable_write(SymbolId name) override {
+            footprint->variable_writes.push_back(name);
+            if (!owner->initial_values.contains(name)) {
+                owner->initial_values.emplace(name, owner->peek(name));
+            }
+        }
+    };
+
+    using Index = std::unordered_map<SymbolId, std::vector<uint32_t>>;
+    using Snapshot = std::vector<std::pair<SymbolId, std::optional<MiniValue>>>;
+
+    const CompiledScript& script;
+    CommandContext& context;
+    std::vector<Footprint> footprints;
+    std::vector<Snapshot> outputs;  ///< Variables each command left behind
+    std::unordered_map<SymbolId, std::optional<MiniValue>> initial_values;
+    std::vector<CommandResult> results;
+    SymbolTable element_names;  ///< Element ids seen by this executor only
+    Index variable_readers;
+    Index variable_writers;
+    Index element_users;  ///< Commands reading or writing each element
+    std::vector<SymbolId> changed_variables;
+    std::vector<SymbolId> changed_elements;
+    size_t executed = 0;
+
+    static void mark_all(std::vector<char>& dirty, const Index& index, SymbolId key,
+                         uint32_t from) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+        for (uint32_t j : it->second) {
+            if (j >= from) {
+                dirty[j] = 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Can an element be rebuilt from scratch by re-running its users?
+     */
+    bool rebuildable(SymbolId element) const {
+        if (!context.get_element_store()) {
+            return false;
+        }
+        auto it = element_users.find(element);
+        return it != element_users.end() &&
+               std::any_of(it->second.begin(), it->second.end(), [&](uint32_t j) {
+                   const std::vector<SymbolId>& created = footprints[j].created;
+                   return std::binary_search(created.begin(), created.end(), element);
+               });
+    }
+
+    /**
+     * @brief Extend dirty to everything that depends on a dirty command
+     * @return Elements to remove before re-executing
+     */
+    std::vector<SymbolId> propagate(std::vector<char>& dirty) {
+        uint32_t count = static_cast<uint32_t>(dirty.size());
+        std::vector<SymbolId> rebuilt;
+        bool again = true;
+        while (again) {
+            again = false;
+            for (uint32_t i = 0; i < count; ++i) {
+                if (!dirty[i]) {
+                    continue;
+                }
+                const Footprint& footprint = footprints[i];
+                if (footprint.barrier) {
+                    std::fill(dirty.begin() + i + 1, dirty.end(), 1);
+                }
+                for (SymbolId id : footprint.variable_writes) {
+                    mark_all(dirty, variable_readers, id, i + 1);
+                    mark_all(dirty, variable_writers, id, i + 1);
+                }
+                auto touch = [&](SymbolId id, bool write) {
+                    if (std::find(rebuilt.begin(), rebuilt.end(), id) != rebuilt.end()) {
+                        return;
+                    }
+                    if (rebuildable(id)) {
+                        rebuilt.push_back(id);
+                        for (uint32_t j : element_users.find(id)->second) {
+                            again |= j < i && !dirty[j];
+                            dirty[j] = 1;
+                        }
+                    } else if (write) {
+                        mark_all(dirty, element_users, id, i + 1);
+                    }
+                };
+                for (SymbolId id : footprint.element_reads) touch(id, false);
+                for (SymbolId id : footprint.element_writes) touch(id, true);
+            }
+            // Anything dirty before a barrier makes the barrier dirty.
+            for (uint32_t i = 0, first = count; i < count; ++i) {
+                if (dirty[i] && first == count) {
+                    first = i;
+                }
+                if (footprints[i].barrier && first < i && !dirty[i]) {
+                    dirty[i] = 1;
+                    again = true;
+                }
+            }
+        }
+        return rebuilt;
+    }
+
+    /**
+     * @brief Execute the selected commands in order, re-recording their
+     * footprints; commands newly affected by a changed footprint are
+     * executed in the same pass
+     */
+    size_t execute(std::vector<char>& selected) {
+        Recorder recorder;
+        recorder.owner = this;
+        ContextObserver* previous = context.get_observer();
+        const std::shared_ptr<ElementStore>& store = context.get_element_store();
+        AccessSet access;
+        bool wrote = false;
+        executed = 0;
+
+        for (uint32_t i = 0; i < selected.size(); ++i) {
+            if (!selected[i]) {
+                continue;
+            }
+            for (SymbolId id : footprints[i].variable_reads) {
+                restore(id, i);
+            }
+            const CompiledCommand& compiled = script.commands[i];
+            Footprint footprint = static_footprint(compiled, access);
+            size_t rows = store ? store->size() : 0;
+            recorder.footprint = &footprint;
+            context.set_observer(&recorder);
+            try {
+                results[i] = execute_compiled(compiled, context);
+            } catch (...) {
+                context.set_observer(previous);
+                throw;
+            }
+            context.set_observer(previous);
+            ++executed;
+
+            for (size_t row = rows; store && row < store->size(); ++row) {
+                auto name = store->id_at(static_cast<ElementStore::Row>(row));
+                SymbolId id = element_names.intern(name);
+                footprint.created.push_back(id);
+                footprint.element_writes.push_back(id);
+            }
+            normalize(footprint);
+            outputs[i].clear();
+            for (SymbolId id : footprint.variable_writes) {
+                outputs[i].emplace_back(id, peek(id));
+            }
+            wrote |= !footprint.variable_writes.empty();
+
+            if (!(footprint == footprints[i])) {
+                // New writes affect later readers that were not selected.
+                for (SymbolId id : footprint.variable_writes) {
+                    mark_all(selected, variable_readers, id, i + 1);
+                }
+                for (SymbolId id : footprint.element_writes) {
+                    mark_all(selected, element_users, id, i + 1);
+                }
+                if (footprint.barrier) {
+                    std::fill(selected.begin() + i + 1, selected.end(), 1);
+                }
+                update_index(i, footprints[i], false);
+                footprints[i] = std::move(footprint);
+                update_index(i, footprints[i], true);
+            }
+        }
+
+        // Leave every variable as its last writer in the script did.
+        if (wrote) {
+            for (const auto& entry : variable_writers) {
+                restore(entry.first, static_cast<uint32_t>(footprints.size()));
+            }
+        }
+        return executed;
+    }
+
+    /**
+     * @brief Set a variable to its value just before command i
+     *
+     * Variables the script never writes are left alone.
+     */
+    void restore(SymbolId id, uint32_t i) {
+        auto writers = variable_writers.find(id);
+        if (writers != variable_writers.end()) {
+            auto last = std::lower_bound(writers->second.begin(), writers->second.end(), i);
+            if (last != writers->second.begin()) {
+                for (const auto& [name, value] : outputs[*(last - 1)]) {
+                    if (name == id) {
+                        assign(id, value);
+                        return;
+                    }
+                }
+            }
+        }
+        auto initial = initial_values.find(id);
+        if (initial != initial_values.end()) {
+            assign(id, initial->second);
+        }
+    }
+
+    /**
+     * @brief Variable access that bypasses the observer
+     */
+    std::optional<MiniValue> peek(SymbolId id) {
+        ContextObserver* previous = context.get_observer();
+        context.set_observer(nullptr);
+        std::optional<MiniValue> value = context.get_variable(id);
+        context.set_observer(previous);
+        return value;
+    }
+
+    void assign(SymbolId id, const std::optional<MiniValue>& value) {
+        ContextObserver* previous = context.get_observer();
+        context.set_observer(nullptr);
+        if (value) {
+            context.set_variable(id, *value);
+        } else {
+            context.remove_variable(id);
+        }
+        context.set_observer(previous);
+    }
+
+    Footprint static_footprint(const CompiledCommand& compiled, AccessSet& access) {
+        describe_access(compiled, access);
+        Footprint footprint;
+        footprint.barrier = access.barrier;
+        for (const std::string& id : access.element_reads) {
+            footprint.element_reads.push_back(element_names.intern(id));
+        }
+        for (const std::string& id : access.element_writes) {
+            footprint.element_writes.push_back(element_names.intern(id));
+        }
+        footprint.variable_reads = access.variable_reads;
+        footprint.variable_writes = access.variable_writes;
+        return footprint;
+    }
+
+    static void normalize(Footprint& footprint) {
+        for (auto* keys : {&footprint.variable_reads, &footprint.variable_writes,
+                           &footprint.element_reads, &footprint.element_writes,
+                           &footprint.created}) {
+            std::sort(keys->begin(), keys->end());
+            keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+        }
+    }
+
+    /**
+     * @brief Add command i under every key of its footprint, or remove it
+     *
+     * Lists stay sorted; during run() each insertion is an append.
+     */
+    void update_index(uint32_t i, const Footprint& footprint, bool add) {
+        auto apply = [&](Index& index, SymbolId key) {
+            std::vector<uint32_t>& list = index[key];
+            auto it = std::lower_bound(list.begin(), list.end(), i);
+            bool present = it != list.end() && *it == i;
+            if (add && !present) {
+                list.insert(it, i);
+            } else if (!add && present) {
+                list.erase(it);
+            }
+        };
+        for (SymbolId id : footprint.variable_reads) apply(variable_readers, id);
+        for (SymbolId id : footprint.variable_writes) apply(variable_writers, id);
+        for (SymbolId id : footprint.element_reads) apply(element_users, id);
+        for (SymbolId id : footprint.element_writes) apply(element_users, id);
+    }
+};
+
+}  // namespace krayon::mini
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace krayon::mini {
+
+/**
+ * @file script_arena.hpp
+ * @brief Per-batch arena for mini language parse and execution state
+ *
+ * Everything allocated while compiling and running one batch dies together,
+ * so it is served from a monotonic buffer and released in one shot instead
+ * of freed object by object.
+ */
+
+/**
+ * @brief Allocation counters for a memory resource
+ */
+struct AllocationStats {
+    size_t allocations = 0;
+    size_t bytes = 0;
+};
+
+/**
+ * @brief Pass-through memory resource that counts allocations
+ */
+class CountingResource : public std::pmr::memory_resource {
+public:
+    explicit CountingResource(
+        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream(upstream) {}
+
+    const AllocationStats& stats() const { return counters; }
+    void reset_stats() { counters = {}; }
+
+private:
+    std::pmr::memory_resource* upstream;
+    AllocationStats counters;
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        ++counters.allocations;
+        counters.bytes += bytes;
+        return upstream->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        upstream->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+/**
+ * @brief Monotonic arena released once per batch
+ *
+ * stats() counts allocations served by the arena in the current batch and
+ * last_batch_stats() those of the batch last released; upstream_stats()
+ * counts the (few, growing) blocks the arena itself took from the heap.
+ */
+class ScriptArena {
+public:
+    explicit ScriptArena(size_t initial_size = 64 * 1024)
+        : buffer(initial_size, &upstream), counting(&buffer) {}
+
+    ScriptArena(const ScriptArena&) = delete;
+    ScriptArena& operator=(const ScriptArena&) = delete;
+
+    /**
+     * @brief Resource to hand to containers living for the batch
+     */
+    std::pmr::memory_resource* resource() { return &counting; }
+
+    /**
+     * @brief Free everything allocated from the arena
+     * @return The counters of the batch just released, also kept as
+     * last_batch_stats()
+     */
+    AllocationStats release() {
+        buffer.release();
+        released = counting.stats();
+        counting.reset_stats();
+        return released;
+    }
+
+    /**
+     * @brief Allocations since the last release()
+     */
+    const AllocationStats& stats() const { return counting.stats(); }
+    const AllocationStats& last_batch_stats() const { return released; }
+    const AllocationStats& upstream_stats() const { return upstream.stats(); }
+
+private:
+    CountingResource upstream;
+    std::pmr::monotonic_buffer_resource buffer;
+    CountingResource counting;
+    AllocationStats released;
+};
+
+}  // namespace krayon::mini
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "script_compiler.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace krayon::mini {
+
+/**
+ * @file script_cache.hpp
+ * @brief LRU cache of compiled scripts keyed by content hash
+ *
+ * Macros and presets are re-submitted verbatim many times per session.
+ * ScriptCache hashes the source, and on a hit returns the previously
+ * compiled script instead of tokenizing and parsing again.
+ */
+
+/**
+ * @brief Fast 64-bit content hash (xxh3-style 16-byte stripes + avalanche)
+ */
+inline uint64_t hash_script(std::string_view source) {
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+
+    auto mix = [](uint64_t lhs, uint64_t rhs) {
+        uint64_t product = (lhs ^ (rhs << 32 | rhs >> 32)) * prime1;
+        return product ^ (product >> 29);
+    };
+
+    const char* p = source.data();
+    size_t length = source.size();
+    uint64_t acc = length * prime1;
+
+    while (length >= 16) {
+        uint64_t lo;
+        uint64_t hi;
+        std::memcpy(&lo, p, 8);
+        std::memcpy(&hi, p + 8, 8);
+        acc += mix(lo ^ prime2, hi ^ prime3);
+        acc = (acc << 31 | acc >> 33) * prime1;
+        p += 16;
+        length -= 16;
+    }
+    if (length > 0) {
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+        std::memcpy(&lo, p, length < 8 ? length : 8);
+        if (length > 8) {
+            std::memcpy(&hi, p + 8, length - 8);
+        }
+        acc += mix(lo ^ prime3, hi ^ prime2);
+    }
+
+    acc ^= acc >> 37;
+    acc *= prime3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+/**
+ * @brief Hit/miss counters for ScriptCache
+ */
+struct ScriptCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;  ///< Estimated memory held by cached entries
+};
+
+/**
+ * @brief Thread-safe LRU cache of compiled scripts
+ *
+ * Misses compile outside the cache lock, so concurrent lookups only wait
+ * for each other's bookkeeping. Entries are charged their source size plus
+ * their compiled command storage against the memory budget; the least
+ * recently used entries are evicted when it is exceeded. Invalid scripts
+ * are not cached. The cached source is kept for verification, so a hash
+ * collision is a miss rather than a wrong result.
+ */
+class ScriptCache {
+public:
+    explicit ScriptCache(ScriptCompiler& compiler, size_t memory_budget = 16 * 1024 * 1024)
+        : compiler(compiler), budget(memory_budget) {}
+
+    /**
+     * @brief Return the compiled form of source, compiling on a miss
+     */
+    std::shared_ptr<const CompiledScript> get_or_compile(std::string_view source) {
+        uint64_t hash = hash_script(source);
+        {
+            std::lock_guard lock(mutex);
+            auto it = index.find(hash);
+            if (it != index.end() && it->second->source == source) {
+                lru.splice(lru.begin(), lru, it->second);
+                ++counters.hits;
+                return it->second->script;
+            }
+            ++counters.misses;
+        }
+
+        // Compile without the lock so hits on other threads are not held up.
+        auto script = std::make_shared<CompiledScript>(compiler.compile(source));
+        if (!script->valid) {
+            return script;
+        }
+
+        std::lock_guard lock(mutex);
+        auto it = index.find(hash);
+        if (it != index.end()) {
+            if (it->second->source == source) {
+                // Another thread compiled the same source meanwhile.
+                lru.splice(lru.begin(), lru, it->second);
+                return it->second->script;
+            }
+            erase(it);
+        }
+
+        lru.push_front({hash, std::string(source), script, entry_size(source, *script)});
+        index[hash] = lru.begin();
+        counters.bytes += lru.front().bytes;
+        counters.entries = lru.size();
+        evict_to(budget);
+        return script;
+    }
+
+    /**
+     * @brief Change the memory budget, evicting as needed
+     */
+    void set_memory_budget(size_t bytes) {
+        std::lock_guard lock(mutex);
+        budget = bytes;
+        evict_to(budget);
+    }
+
+    void clear() {
+        std::lock_guard lock(mutex);
+        lru.clear();
+        index.clear();
+        counters.bytes = 0;
+        counters.entries = 0;
+    }
+
+    ScriptCacheStats stats() const {
+        std::lock_guard lock(mutex);
+        return counters;
+    }
+
+private:
+    struct Entry {
+        uint64_t hash;
+        std::string source;
+        std::shared_ptr<const CompiledScript> script;
+        size_t bytes;
+    };
+
+    ScriptCompiler& compiler;
+    size_t budget;
+    mutable std::mutex mutex;
+    std::list<Entry> lru;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    ScriptCacheStats counters;
+
+    static size_t entry_size(std::string_view source, const CompiledScript& script) {
+        return sizeof(Entry) + sizeof(CompiledScript) + source.size() +
+               script.commands.capacity() * sizeof(CompiledCommand);
+    }
+
+    void erase(std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator it) {
+        counters.bytes -= it->second->bytes;
+        lru.erase(it->second);
+        index.erase(it);
+        counters.entries = lru.size();
+    }
+
+    void evict_to(size_t limit) {
+        while (counters.bytes > limit && !lru.empty()) {
+            erase(index.find(lru.back().hash));
+            ++counters.evictions;
+        }
+    }
+};
+
+}  // namespace krayon::mini
@@ -0,0 +1,587 @@
+#pragma once
+
+#include "command_schema.hpp"
+#include "expression.hpp"
+#include "loop.hpp"
+#include "number_parse.hpp"
+#include "script_arena.hpp"
+#include "sealed_registry.hpp"
+#include "token_stream.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file script_compiler.hpp
+ * @brief Compiles mini language source into slot-bound commands
+ *
+ * Grammar (one command per statement, optional ';' separators):
+ *
+ *     statement := command | loop
+ *     command   := identifier '(' [argument (',' argument)*] ')'
+ *     argument  := identifier (':' | '=') expr
+ *     expr      := product (('+' | '-') product)*
+ *     product   := unary (('*' | '/') unary)*
+ *     unary     := '-' unary | '(' expr ')' | variable | literal
+ *     literal   := number | string | true | false | null
+ *     loop      := 'for' identifier 'in' expr '..' expr '{' command* '}'
+ *
+ * Identifiers in expressions name context variables. Constant
+ * subexpressions are folded here; arguments that still depend on
+ * variables compile to an ExprProgram evaluated at execution (see
+ * expression.hpp). Loop bounds must fold to integer constants.
+ *
+ * Each command is resolved against a SealedCommandRegistry and its
+ * arguments are written directly into slots of the command's schema.
+ * Defaults and validation happen here, once per compile.
+ */
+
+/**
+ * @brief Result of compiling a script
+ */
+struct CompiledScript {
+    explicit CompiledScript(
+        std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : commands(memory) {}
+
+    std::pmr::vector<CompiledCommand> commands;
+    bool valid = false;
+    std::string error;
+    size_t error_offset = 0;
+};
+
+/**
+ * @brief Compiler from source text to CompiledScript
+ *
+ * Schemas are cached per command for the compiler's lifetime. Compiled
+ * commands point into the registry and the schema cache, so they must not
+ * outlive either. The caches are locked, so one compiler may compile on
+ * several threads at once.
+ */
+class ScriptCompiler {
+public:
+    explicit ScriptCompiler(const SealedCommandRegistry& registry) : registry(registry) {}
+
+    /**
+     * @brief Compile a whole script; stops at the first error
+     * @param memory Resource for the command list, expression programs and
+     *               compile scratch, e.g. a ScriptArena
+     */
+    CompiledScript compile(std::string_view source,
+                           std::pmr::memory_resource* memory = std::pmr::get_default_resource()) {
+        CompiledScript script(memory);
+        TokenStream tokens(source);
+        while (true) {
+            CompiledCommand compiled;
+            CommandResult status = compile_next(tokens, compiled, memory);
+            if (!status.success) {
+                script.error = status.message;
+                script.error_offset = tokens.offset();
+                return script;
+            }
+            if (compiled.empty()) {
+                break;
+            }
+            script.commands.push_back(std::move(compiled));
+        }
+        script.valid = true;
+        return script;
+    }
+
+    /**
+     * @brief Compile the next command or loop from a token stream
+     *
+     * On success with no more input, out is left empty().
+     *
+     * @param memory Resource for compile scratch and expression programs
+     */
+    CommandResult compile_next(TokenStream& tokens, CompiledCommand& out,
+                               std::pmr::memory_resource* memory =
+                                   std::pmr::get_default_resource()) {
+        using TokenType = Tokenizer::TokenType;
+
+        while (tokens.peek().type == TokenType::Semicolon) {
+            tokens.next();
+        }
+        TokenView name = tokens.next();
+        if (name.type == TokenType::End) {
+            return tokens.failed() ? error_at(name, "Unexpected character")
+                                   : CommandResult(true);
+        }
+        if (name.type == TokenType::Keyword && name.text == "for") {
+            return compile_loop(tokens, name, out, memory);
+        }
+        if (name.type != TokenType::Identifier) {
+            return error_at(name, "Expected command name");
+        }
+        return compile_call(tokens, name, out, nullptr, memory);
+    }
+
+    const SealedCommandRegistry& get_registry() const { return registry; }
+
+    /**
+     * @brief Cached schema of a command; valid for the compiler's lifetime
+     */
+    const CommandSchema& schema_for(const SceneCommand* command) {
+        std::lock_guard lock(cache_mutex);
+        auto& schema = schemas[command];
+        if (!schema) {
+            schema = std::make_unique<CommandSchema>(*command);
+        }
+        return *schema;
+    }
+
+private:
+    const SealedCommandRegistry& registry;
+    std::unordered_map<const SceneCommand*, std::unique_ptr<CommandSchema>> schemas;
+    std::unordered_map<const SceneCommand*, uint32_t> selector_masks;
+    std::mutex cache_mutex;  ///< Guards schemas and selector_masks
+
+    /**
+     * @brief Selector slots of a command, or 0 if it takes no selectors
+     */
+    uint32_t selector_mask_for(const SceneCommand* command, const CommandSchema& schema) {
+        std::lock_guard lock(cache_mutex);
+        auto it = selector_masks.find(command);
+        if (it == selector_masks.end()) {
+            uint32_t mask = supports_selectors(command->get_name()) ? selector_slot_mask(schema) : 0;
+            it = selector_masks.emplace(command, mask).first;
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Loop being compiled, for arguments that may use its variable
+     */
+    struct LoopScope {
+        SymbolId variable = invalid_symbol;
+        int64_t first = 0;
+        std::vector<LoopArgument>* varying = nullptr;
+    };
+
+    /**
+     * @brief Argument expressions of one command, sharing one DAG for CSE
+     */
+    struct ArgumentExprs {
+        explicit ArgumentExprs(std::pmr::memory_resource* memory)
+            : builder(memory), dynamic(memory) {}
+
+        ExprBuilder builder;
+        std::pmr::vector<std::pair<uint8_t, ExprBuilder::Node>> dynamic;  ///< (slot, root)
+    };
+
+    CommandResult compile_call(TokenStream& tokens, const TokenView& name,
+                               CompiledCommand& out, const LoopScope* scope,
+                               std::pmr::memory_resource* memory) {
+        using TokenType = Tokenizer::TokenType;
+
+        SceneCommand* command = registry.find(name.text);
+        if (!command) {
+            return error_at(name, "Unknown command: " + std::string(name.text));
+        }
+        const CommandSchema& schema = schema_for(command);
+        if (!schema.status().success) {
+            return error_at(name, schema.status().message);
+        }
+
+        out.command = command;
+        out.slot_command = dynamic_cast<SlotCommand*>(command);
+        out.schema = &schema;
+        out.source_offset = name.position;
+
+        if (tokens.next().type != TokenType::OpenParen) {
+            return error_at(name, "Expected '(' after command name");
+        }
+        ArgumentExprs exprs(memory);
+        if (tokens.peek().type == TokenType::CloseParen) {
+            tokens.next();
+        } else {
+            while (true) {
+                CommandResult status = compile_argument(tokens, schema, out.args, exprs, scope);
+                if (!status.success) {
+                    return status;
+                }
+                TokenView separator = tokens.next();
+                if (separator.type == TokenType::CloseParen) {
+                    break;
+                }
+                if (separator.type != TokenType::Comma) {
+                    return error_at(separator, "Expected ',' or ')'");
+                }
+            }
+        }
+
+        uint32_t deferred = 0;
+        if (!exprs.dynamic.empty()) {
+            auto program = std::allocate_shared<ExprProgram>(
+                std::pmr::polymorphic_allocator<ExprProgram>(memory), memory);
+            if (!exprs.builder.emit(exprs.dynamic, *program)) {
+                return error_at(name, "Expressions too complex");
+            }
+            deferred = program->slot_mask();
+            out.program = std::move(program);
+        }
+
+        uint32_t selectors = selector_mask_for(command, schema);
+        uint32_t waived = 0;
+        if (selectors) {
+            CommandResult target = check_target(schema, out.args.present | deferred, selectors);
+            if (!target.success) {
+                return target;
+            }
+            out.selector_slots = (out.args.present | deferred) & selectors;
+            waived = target_waiver(schema, out.selector_slots);
+        }
+        CommandResult status = schema.finalize(out.args, deferred | waived);
+        if (!status.success || out.program || out.selector_slots) {
+            // Commands with computed arguments are validated when they run;
+            // selections are checked by execute_selection().
+            return status;
+        }
+        if (out.slot_command) {
+            return out.slot_command->validate_slots(out.args);
+        }
+        return command->validate_parameters(schema.to_map(out.args));
+    }
+
+    /**
+     * @brief Compile `for v in a..b { ... }` after the 'for' keyword
+     *
+     * Body commands are validated with the first iteration's arguments;
+     * varying arguments keep the same kind on every iteration.
+     */
+    CommandResult compile_loop(TokenStream& tokens, const TokenView& keyword,
+                               CompiledCommand& out, std::pmr::memory_resource* memory) {
+        using TokenType = Tokenizer::TokenType;
+
+        TokenView variable = tokens.next();
+        if (variable.type != TokenType::Identifier) {
+            return error_at(variable, "Expected loop variable");
+        }
+        TokenView in = tokens.next();
+        if (in.type != TokenType::Keyword || in.text != "in") {
+            return error_at(in, "Expected 'in' after loop variable");
+        }
+
+        auto loop = std::make_shared<CompiledLoop>();
+        loop->variable = intern(variable.text);
+        CommandResult status = compile_bound(tokens, loop->begin);
+        if (!status.success) {
+            return status;
+        }
+        TokenView range = tokens.next();
+        if (range.type != TokenType::Range) {
+            return error_at(range, "Expected '..' in loop range");
+        }
+        status = compile_bound(tokens, loop->end);
+        if (!status.success) {
+            return status;
+        }
+        TokenView open = tokens.next();
+        if (open.type != TokenType::OpenBrace) {
+            return error_at(open, "Expected '{' after loop range");
+        }
+
+        while (true) {
+            while (tokens.peek().type == TokenType::Semicolon) {
+                tokens.next();
+            }
+            TokenView name = tokens.next();
+            if (name.type == TokenType::CloseBrace) {
+                break;
+            }
+            if (name.type == TokenType::End) {
+                return error_at(name, tokens.failed() ? "Unexpected character"
+                                                      : "Expected '}' to close loop body");
+            }
+            if (name.type == TokenType::Keyword && name.text == "for") {
+                return error_at(name, "Nested loops are not supported");
+            }
+            if (name.type != TokenType::Identifier) {
+                return error_at(name, "Expected command name");
+            }
+
+            LoopBodyCommand body;
+            LoopScope scope{loop->variable, loop->begin, &body.varying};
+            status = compile_call(tokens, name, body.command, &scope, memory);
+            if (!status.success) {
+                return status;
+            }
+            loop->body.push_back(std::move(body));
+        }
+
+        classify_bulk(*loop);
+        out.source_offset = keyword.position;
+        out.loop = std::move(loop);
+        return CommandResult(true);
+    }
+
+    CommandResult compile_bound(TokenStream& tokens, int64_t& bound) {
+        ExprBuilder builder;
+        ExprBuilder::Node node;
+        TokenView token = tokens.peek();
+        CommandResult status = compile_sum(tokens, builder, node);
+        if (!status.success) {
+            return status;
+        }
+        if (!builder.is_constant(node)) {
+            return error_at(token, "Loop bounds must be constant");
+        }
+        const double* number = std::get_if<double>(&builder.get(node).constant);
+        if (!number || std::nearbyint(*number) != *number || std::fabs(*number) > 1e15) {
+            return error_at(token, "Loop bounds must be integers");
+        }
+        bound = static_cast<int64_t>(*number);
+        return CommandResult(true);
+    }
+
+    static CommandResult error_at(const TokenView& token, const std::string& message) {
+        return CommandResult(false, message + " at offset " + std::to_string(token.position));
+    }
+
+    CommandResult compile_argument(TokenStream& tokens, const CommandSchema& schema,
+                                   BoundArguments& args, ArgumentExprs& exprs,
+                                   const LoopScope* scope) {
+        using TokenType = Tokenizer::TokenType;
+
+        TokenView key = tokens.next();
+        if (key.type != TokenType::Identifier) {
+            return error_at(key, "Expected parameter name");
+        }
+        auto id = SymbolTable::global().find(key.text);
+        int slot = id ? schema.slot_of(*id) : -1;
+        if (slot < 0) {
+            return error_at(key, "Unknown parameter: " + std::string(key.text));
+        }
+        TokenView assign = tokens.next();
+        if (assign.type != TokenType::Colon && assign.type != TokenType::Equals) {
+            return error_at(assign, "Expected ':' or '=' after parameter name");
+        }
+
+        // Fast path for a plain literal, by far the most common argument.
+        TokenView first = tokens.next();
+        TokenType after = tokens.peek().type;
+        if (after == TokenType::Comma || after == TokenType::CloseParen) {
+            MiniValue value;
+            CommandResult status = compile_literal(first, value);
+            if (status.success) {
+                set_constant(slot, std::move(value), args, exprs, scope);
+                return status;
+            }
+        }
+
+        ExprBuilder::Node node;
+        CommandResult status = compile_sum(tokens, exprs.builder, node, &first);
+        if (!status.success) {
+            return status;
+        }
+        if (exprs.builder.is_constant(node)) {
+            set_constant(slot, exprs.builder.get(node).constant, args, exprs, scope);
+            return CommandResult(true);
+        }
+
+        forget_slot(slot, exprs, scope);
+        if (scope) {
+            if (auto expr = to_loop_expr(exprs.builder, node, scope->variable)) {
+                args.set(static_cast<size_t>(slot), expr->evaluate(scope->first));
+                scope->varying->push_back({static_cast<uint8_t>(slot), std::move(*expr)});
+                return CommandResult(true);
+            }
+        }
+        args.present &= ~(uint32_t{1} << slot);
+        exprs.dynamic.emplace_back(static_cast<uint8_t>(slot), node);
+        return CommandResult(true);
+    }
+
+    /**
+     * @brief Drop an earlier computed value for a repeated parameter
+     */
+    static void forget_slot(int slot, ArgumentExprs& exprs, const LoopScope* scope) {
+        std::erase_if(exprs.dynamic, [slot](const auto& entry) { return entry.first == slot; });
+        if (scope) {
+            std::erase_if(*scope->varying,
+                          [slot](const LoopArgument& argument) { return argument.slot == slot; });
+        }
+    }
+
+    static void set_constant(int slot, MiniValue value, BoundArguments& args,
+                             ArgumentExprs& exprs, const LoopScope* scope) {
+        forget_slot(slot, exprs, scope);
+        args.set(static_cast<size_t>(slot), std::move(value));
+    }
+
+    /**
+     * @brief sum := product (('+' | '-') product)*
+     * @param first First token of the expression if already consumed
+     */
+    CommandResult compile_sum(TokenStream& tokens, ExprBuilder& builder, ExprBuilder::Node& node,
+                              const TokenView* first = nullptr) {
+        using TokenType = Tokenizer::TokenType;
+
+        CommandResult status = compile_product(tokens, builder, node, first);
+        while (status.success && (tokens.peek().type == TokenType::Plus ||
+                                  tokens.peek().type == TokenType::Minus)) {
+            TokenView op = tokens.next();
+            ExprBuilder::Node rhs;
+            status = compile_product(tokens, builder, rhs);
+            const char* error = nullptr;
+            if (status.success &&
+                !builder.binary(op.type == TokenType::Plus ? ExprOp::Add : ExprOp::Subtract,
+                                node, rhs, node, error)) {
+                return error_at(op, error);
+            }
+        }
+        return status;
+    }
+
+    /**
+     * @brief product := unary (('*' | '/') unary)*
+     */
+    CommandResult compile_product(TokenStream& tokens, ExprBuilder& builder,
+                                  ExprBuilder::Node& node, const TokenView* first = nullptr) {
+        using TokenType = Tokenizer::TokenType;
+
+        CommandResult status = compile_unary(tokens, builder, node, first);
+        while (status.success && (tokens.peek().type == TokenType::Multiply ||
+                                  tokens.peek().type == TokenType::Divide)) {
+            TokenView op = tokens.next();
+            ExprBuilder::Node rhs;
+            status = compile_unary(tokens, builder, rhs);
+            const char* error = nullptr;
+            if (status.success &&
+                !builder.binary(op.type == TokenType::Multiply ? ExprOp::Multiply : ExprOp::Divide,
+                                node, rhs, node, error)) {
+                return error_at(op, error);
+            }
+        }
+        return status;
+    }
+
+    /**
+     * @brief unary := '-' unary | '(' sum ')' | variable | literal
+     */
+    CommandResult compile_unary(TokenStream& tokens, ExprBuilder& builder,
+                                ExprBuilder::Node& node, const TokenView* first = nullptr) {
+        using TokenType = Tokenizer::TokenType;
+
+        TokenView token = first ? *first : tokens.next();
+        switch (token.type) {
+            case TokenType::Minus: {
+                ExprBuilder::Node operand;
+                CommandResult status = compile_unary(tokens, builder, operand);
+                const char* error = nullptr;
+                if (status.success && !builder.negate(operand, node, error)) {
+                    return error_at(token, error);
+                }
+                return status;
+            }
+            case TokenType::OpenParen: {
+                CommandResult status = compile_sum(tokens, builder, node);
+                if (!status.success) {
+                    return status;
+                }
+                TokenView close = tokens.next();
+                if (close.type != TokenType::CloseParen) {
+                    return error_at(close, "Expected ')'");
+                }
+                return status;
+            }
+            case TokenType::Identifier:
+                node = builder.variable(intern(token.text));
+                return CommandResult(true);
+            default: {
+                MiniValue value;
+                CommandResult status = compile_literal(token, value);
+                if (status.success) {
+                    node = builder.constant(std::move(value));
+                }
+                return status;
+            }
+        }
+    }
+
+    CommandResult compile_literal(const TokenView& token, MiniValue& value) {
+        using TokenType = Tokenizer::TokenType;
+
+        switch (token.type) {
+            case TokenType::Number: {
+                auto number = parse_number(token.text);
+                if (!number) {
+                    return error_at(token, "Invalid number");
+                }
+                value = *number;
+                return CommandResult(true);
+            }
+            case TokenType::String:
+                value = decode_string(token);
+                return CommandResult(true);
+            case TokenType::Keyword:
+                if (token.text == "null") {
+                    value = std::monostate();
+                } else if (token.text == "true" || token.text == "false") {
+                    value = token.text == "true";
+                } else {
+                    return error_at(token, "Expected value");
+                }
+                return CommandResult(true);
+            default:
+                return error_at(token, "Expected value");
+        }
+    }
+};
+
+/**
+ * @brief Execute every command of a compiled script in order
+ */
+inline std::vector<CommandResult> execute_script(const CompiledScript& script,
+                                                 CommandContext& context) {
+    std::vector<CommandResult> results;
+    results.reserve(script.commands.size());
+    for (const CompiledCommand& compiled : script.commands) {
+        results.push_back(execute_compiled(compiled, context));
+    }
+    return results;
+}
+
+/**
+ * @brief Compile and run a batch with all transient state in an arena
+ *
+ * The compiled commands and anything commands allocate from the context's
+ * memory resource come from the arena, which is released when the batch
+ * finishes, also if a command throws; its counters stay available as
+ * ScriptArena::last_batch_stats(). Only the results outlive the call.
+ */
+inline std::vector<CommandResult> execute_batch_in_arena(ScriptCompiler& compiler,
+                                                         std::string_view source,
+                                                         CommandContext& context,
+                                                         ScriptArena& arena) {
+    // Restores the context's resource and releases the arena on every way
+    // out; declared before the script so it runs after the script is gone.
+    struct BatchScope {
+        CommandContext& context;
+        ScriptArena& arena;
+        std::pmr::memory_resource* previous;
+        ~BatchScope() {
+            context.set_memory_resource(previous);
+            arena.release();
+        }
+    } scope{context, arena, context.get_memory_resource()};
+
+    CompiledScript script = compiler.compile(source, arena.resource());
+    if (!script.valid) {
+        return {CommandResult(false, script.error)};
+    }
+    context.set_memory_resource(arena.resource());
+    return execute_script(script, context);
+}
+
+}  // namespace krayon::mini
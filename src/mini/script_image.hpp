@@ -0,0 +1,555 @@
+#pragma once
+
+#include "loop.hpp"
+#include "script_cache.hpp"
+#include "script_compiler.hpp"
+#include "script_stream.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file script_image.hpp
+ * @brief Precompiled scripts stored as versioned binary images
+ *
+ * A script image holds a CompiledScript in a form that loads without
+ * tokenizing, parsing, number conversion, expression building or argument
+ * validation:
+ *
+ *     header      magic, format version, byte order, source hash, checksum
+ *     symbols     every string the script uses, once
+ *     signatures  name and parameter slots of each command used, with
+ *                 their kinds, required flags and defaults
+ *     code        commands with their bound constants, argument programs
+ *                 and loops; strings refer to the symbol section
+ *
+ * save_script_image() is the ahead-of-time step. load_script_image() maps
+ * the file and rebuilds the script in one pass; argument strings are copied
+ * straight from the mapping, and only names are interned. Each call is
+ * still checked against its schema (required parameters, defaults, kinds
+ * and the id a selector stands in for), which is cheap next to parsing. An
+ * image is rejected if its version or byte order differs, if the checksum
+ * fails, or if a command is missing from the registry or its parameters
+ * changed since the image was written; recompile from source then. The
+ * header's source hash lets callers detect a stale image without reading
+ * the rest.
+ */
+
+inline constexpr char script_image_magic[8] = {'K', 'R', 'Y', 'S', 'C', 'R', 'P', 'T'};
+inline constexpr uint32_t script_image_version = 2;
+inline constexpr uint32_t script_image_byte_order = 0x01020304;
+
+/**
+ * @brief Fixed-size header at the start of every image
+ */
+struct ScriptImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;       ///< script_image_byte_order in the writer's byte order
+    uint64_t source_hash;      ///< hash_script() of the source, or 0
+    uint64_t checksum;         ///< hash_script() of everything after the header
+    uint32_t symbol_count;
+    uint32_t signature_count;
+    uint32_t command_count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ScriptImageHeader) == 48);
+
+/**
+ * @brief Encoder and decoder of the image format
+ */
+class ScriptImageCodec {
+public:
+    /**
+     * @brief Serialize a valid script
+     */
+    static std::string encode(const CompiledScript& script, uint64_t source_hash) {
+        Encoder encoder;
+        for (const CompiledCommand& compiled : script.commands) {
+            encoder.command(compiled);
+        }
+
+        std::string image(sizeof(ScriptImageHeader), '\0');
+        for (SymbolId id : encoder.symbols) {
+            std::string_view name = SymbolTable::global().name(id);
+            put(image, static_cast<uint32_t>(name.size()));
+            image += name;
+        }
+        for (const CommandSchema* schema : encoder.schemas) {
+            const auto& slots = schema->get_slots();
+            put(image, *encoder.symbol_index.find(encoder.signature_names[schema]));
+            put(image, static_cast<uint8_t>(slots.size()));
+            const std::vector<uint64_t>& defaults = encoder.default_values[schema];
+            for (size_t i = 0; i < slots.size(); ++i) {
+                put(image, *encoder.symbol_index.find(slots[i].name));
+                put(image, static_cast<uint8_t>(slots[i].kind));
+                put(image, static_cast<uint8_t>(slots[i].required ? 1 : 0));
+                put(image, defaults[i]);
+            }
+        }
+        image += encoder.code;
+
+        ScriptImageHeader header{};
+        std::memcpy(header.magic, script_image_magic, sizeof(header.magic));
+        header.version = script_image_version;
+        header.byte_order = script_image_byte_order;
+        header.source_hash = source_hash;
+        header.checksum = hash_script(std::string_view(image).substr(sizeof(header)));
+        header.symbol_count = static_cast<uint32_t>(encoder.symbols.size());
+        header.signature_count = static_cast<uint32_t>(encoder.schemas.size());
+        header.command_count = static_cast<uint32_t>(script.commands.size());
+        std::memcpy(image.data(), &header, sizeof(header));
+        return image;
+    }
+
+    /**
+     * @brief Header of an image, or nullopt if it is not a current image
+     */
+    static std::optional<ScriptImageHeader> read_header(std::string_view image) {
+        ScriptImageHeader header;
+        if (image.size() < sizeof(header)) {
+            return std::nullopt;
+        }
+        std::memcpy(&header, image.data(), sizeof(header));
+        if (std::memcmp(header.magic, script_image_magic, sizeof(header.magic)) != 0 ||
+            header.version != script_image_version ||
+            header.byte_order != script_image_byte_order) {
+            return std::nullopt;
+        }
+        return header;
+    }
+
+    /**
+     * @brief Rebuild a script from an image
+     *
+     * The result points into the compiler's registry and schema cache, like
+     * a script compiled from source.
+     */
+    static CompiledScript decode(ScriptCompiler& compiler, std::string_view image,
+                                 std::pmr::memory_resource* memory) {
+        CompiledScript script(memory);
+        std::optional<ScriptImageHeader> header = read_header(image);
+        if (!header) {
+            script.error = "Not a script image of version " + std::to_string(script_image_version);
+            return script;
+        }
+        Decoder decoder(image.substr(sizeof(ScriptImageHeader)));
+        if (hash_script(decoder.data) != header->checksum) {
+            script.error = "Script image checksum mismatch";
+            return script;
+        }
+
+        // Counts are bounded by the payload size before reserving.
+        decoder.texts.reserve(std::min<size_t>(header->symbol_count, decoder.data.size()));
+        for (uint32_t i = 0; i < header->symbol_count && decoder.ok; ++i) {
+            uint32_t length = decoder.get<uint32_t>();
+            if (decoder.data.size() - decoder.position < length) {
+                decoder.ok = false;
+                break;
+            }
+            decoder.texts.push_back(decoder.data.substr(decoder.position, length));
+            decoder.position += length;
+        }
+        decoder.symbols.assign(decoder.texts.size(), invalid_symbol);
+
+        const SealedCommandRegistry& registry = compiler.get_registry();
+        for (uint32_t i = 0; i < header->signature_count && decoder.ok; ++i) {
+            SymbolId name = decoder.symbol();
+            uint8_t count = decoder.get<uint8_t>();
+            SceneCommand* command = decoder.ok ? registry.find(name) : nullptr;
+            if (decoder.ok && !command) {
+                fail(script, decoder, "Unknown command in script image: " +
+                                          std::string(SymbolTable::global().name(name)));
+                return script;
+            }
+            const CommandSchema* schema = command ? &compiler.schema_for(command) : nullptr;
+            bool matches = schema && schema->get_slots().size() == count;
+            for (uint8_t slot = 0; slot < count; ++slot) {
+                SymbolId parameter = decoder.symbol();
+                auto kind = static_cast<ValueKind>(decoder.get<uint8_t>());
+                bool required = decoder.get<uint8_t>() != 0;
+                MiniValue default_value = decoder.mini_value();
+                matches = matches && schema->get_slots()[slot].name == parameter &&
+                          schema->get_slots()[slot].kind == kind &&
+                          schema->get_slots()[slot].required == required &&
+                          schema->get_slots()[slot].default_value == default_value;
+            }
+            if (decoder.ok && !matches) {
+                fail(script, decoder,
+                     "Parameters of " + std::string(SymbolTable::global().name(name)) +
+                         " changed since the script image was written");
+                return script;
+            }
+            uint32_t selectors =
+                command && supports_selectors(command->get_name()) ? selector_slot_mask(*schema) : 0;
+            decoder.signatures.push_back({command, schema, selectors});
+        }
+
+        script.commands.reserve(std::min<size_t>(header->command_count, decoder.data.size()));
+        for (uint32_t i = 0; i < header->command_count && decoder.ok; ++i) {
+            CompiledCommand compiled;
+            decoder.command(compiled);
+            script.commands.push_back(std::move(compiled));
+        }
+        if (!decoder.ok || decoder.position != decoder.data.size()) {
+            fail(script, decoder, "Malformed script image");
+            return script;
+        }
+        script.valid = true;
+        return script;
+    }
+
+private:
+    template<typename T>
+    static void put(std::string& out, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    struct Encoder {
+        std::string code;
+        std::vector<SymbolId> symbols;
+        SymbolMap<uint32_t> symbol_index;
+        std::vector<const CommandSchema*> schemas;
+        std::unordered_map<const CommandSchema*, uint32_t> schema_index;
+        std::unordered_map<const CommandSchema*, SymbolId> signature_names;
+        std::unordered_map<const CommandSchema*, std::vector<uint64_t>> default_values;
+
+        uint32_t symbol_of(SymbolId id) {
+            if (const uint32_t* index = symbol_index.find(id)) {
+                return *index;
+            }
+            auto index = static_cast<uint32_t>(symbols.size());
+            symbols.push_back(id);
+            symbol_index.insert_or_assign(id, index);
+            return index;
+        }
+
+        uint64_t encode_value(Value value) {
+            if (value.is_string()) {
+                value = Value::symbol(symbol_of(value.as_symbol()));
+            }
+            return value.raw();
+        }
+
+        void value(Value value) { put(code, encode_value(value)); }
+
+        void value(const MiniValue& value) { this->value(Value::from_mini(value)); }
+
+        void command(const CompiledCommand& compiled) {
+            put(code, static_cast<uint8_t>(compiled.loop ? 1 : 0));
+            if (compiled.loop) {
+                loop(*compiled.loop, compiled.source_offset);
+            } else {
+                call(compiled);
+            }
+        }
+
+        void call(const CompiledCommand& compiled) {
+            auto [it, added] = schema_index.emplace(compiled.schema,
+                                                    static_cast<uint32_t>(schemas.size()));
+            if (added) {
+                // Register the signature's symbols before the symbol section
+                // is written.
+                schemas.push_back(compiled.schema);
+                SymbolId name = intern(compiled.command->get_name());
+                signature_names[compiled.schema] = name;
+                symbol_of(name);
+                std::vector<uint64_t>& defaults = default_values[compiled.schema];
+                for (const ParameterSlot& slot : compiled.schema->get_slots()) {
+                    symbol_of(slot.name);
+                    defaults.push_back(encode_value(Value::from_mini(slot.default_value)));
+                }
+            }
+            put(code, it->second);
+            put(code, static_cast<uint32_t>(compiled.source_offset));
+            put(code, compiled.args.present);
+            put(code, compiled.selector_slots);
+            for (size_t slot = 0; slot < max_parameter_slots; ++slot) {
+                if (compiled.args.has(slot)) {
+                    value(compiled.args.values[slot]);
+                }
+            }
+            put(code, static_cast<uint8_t>(compiled.program ? 1 : 0));
+            if (compiled.program) {
+                program(*compiled.program);
+            }
+        }
+
+        void program(const ExprProgram& program) {
+            put(code, static_cast<uint16_t>(program.initial.size()));
+            for (Value constant : program.initial) {
+                value(constant);
+            }
+            put(code, static_cast<uint16_t>(program.code.size()));
+            for (const ExprProgram::Instruction& in : program.code) {
+                put(code, in);
+            }
+            put(code, static_cast<uint16_t>(program.variables.size()));
+            for (SymbolId variable : program.variables) {
+                put(code, symbol_of(variable));
+            }
+            put(code, static_cast<uint16_t>(program.outputs.size()));
+            for (const ExprProgram::Output& output : program.outputs) {
+                put(code, output);
+            }
+        }
+
+        void loop(const CompiledLoop& loop, size_t source_offset) {
+            put(code, static_cast<uint32_t>(source_offset));
+            put(code, symbol_of(loop.variable));
+            put(code, loop.begin);
+            put(code, loop.end);
+            put(code, static_cast<uint32_t>(loop.body.size()));
+            for (const LoopBodyCommand& body : loop.body) {
+                call(body.command);
+                put(code, static_cast<uint8_t>(body.varying.size()));
+                for (const LoopArgument& argument : body.varying) {
+                    put(code, argument.slot);
+                    put(code, static_cast<uint8_t>(argument.expr.kind));
+                    value(argument.expr.constant);
+                    put(code, argument.expr.scale);
+                    put(code, argument.expr.offset);
+                    value(Value::string(argument.expr.prefix));
+                    value(Value::string(argument.expr.suffix));
+                }
+            }
+        }
+    };
+
+    struct Signature {
+        SceneCommand* command;
+        const CommandSchema* schema;
+        uint32_t selectors;  ///< Selector slots the command accepts
+    };
+
+    class Decoder {
+    public:
+        std::string_view data;
+        size_t position = 0;
+        bool ok = true;
+        std::vector<std::string_view> texts;  ///< Symbol section, in the image
+        std::vector<SymbolId> symbols;        ///< Interned on first use
+        std::vector<Signature> signatures;
+
+        explicit Decoder(std::string_view data) : data(data) {}
+
+        template<typename T>
+        T get() {
+            T value{};
+            if (!ok || data.size() - position < sizeof(T)) {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, data.data() + position, sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        SymbolId symbol_at(uint32_t index) {
+            if (index >= texts.size()) {
+                ok = false;
+                return invalid_symbol;
+            }
+            if (symbols[index] == invalid_symbol) {
+                symbols[index] = intern(texts[index]);
+            }
+            return symbols[index];
+        }
+
+        SymbolId symbol() { return symbol_at(get<uint32_t>()); }
+
+        Value value() {
+            Value value = Value::from_raw(get<uint64_t>());
+            return value.is_string() ? Value::symbol(symbol_at(value.as_symbol())) : value;
+        }
+
+        /**
+         * @brief Argument constant; strings are copied from the image
+         * without being interned
+         */
+        MiniValue mini_value() {
+            Value value = Value::from_raw(get<uint64_t>());
+            if (!value.is_string()) {
+                return value.to_mini();
+            }
+            if (value.as_symbol() >= texts.size()) {
+                ok = false;
+                return std::monostate();
+            }
+            return std::string(texts[value.as_symbol()]);
+        }
+
+        void command(CompiledCommand& out) {
+            if (get<uint8_t>() == 0) {
+                call(out);
+                return;
+            }
+            auto loop = std::make_shared<CompiledLoop>();
+            out.source_offset = get<uint32_t>();
+            loop->variable = symbol();
+            loop->begin = get<int64_t>();
+            loop->end = get<int64_t>();
+            uint32_t count = get<uint32_t>();
+            for (uint32_t i = 0; i < count && ok; ++i) {
+                LoopBodyCommand body;
+                call(body.command);
+                uint8_t varying = get<uint8_t>();
+                for (uint8_t k = 0; k < varying && ok; ++k) {
+                    LoopArgument argument;
+                    argument.slot = get<uint8_t>();
+                    argument.expr.kind = static_cast<LoopExpr::Kind>(get<uint8_t>());
+                    argument.expr.constant = mini_value();
+                    argument.expr.scale = get<double>();
+                    argument.expr.offset = get<double>();
+                    argument.expr.prefix = text();
+                    argument.expr.suffix = text();
+                    ok = ok && argument.slot < body.command.schema->get_slots().size() &&
+                         argument.expr.kind <= LoopExpr::Kind::Concat;
+                    body.varying.push_back(std::move(argument));
+                }
+                loop->body.push_back(std::move(body));
+            }
+            if (ok) {
+                classify_bulk(*loop);
+            }
+            out.loop = std::move(loop);
+        }
+
+        void call(CompiledCommand& out) {
+            uint32_t index = get<uint32_t>();
+            if (!ok || index >= signatures.size()) {
+                ok = false;
+                return;
+            }
+            const Signature& signature = signatures[index];
+            out.command = signature.command;
+            out.slot_command = dynamic_cast<SlotCommand*>(out.command);
+            out.schema = signature.schema;
+            out.source_offset = get<uint32_t>();
+            uint32_t present = get<uint32_t>();
+            out.selector_slots = get<uint32_t>();
+            size_t slot_count = out.schema->get_slots().size();
+            if ((present | out.selector_slots) >> slot_count ||
+                (out.selector_slots & ~signature.selectors)) {
+                ok = false;
+                return;
+            }
+            for (size_t slot = 0; slot < slot_count; ++slot) {
+                if ((present >> slot) & 1u) {
+                    out.args.set(slot, mini_value());
+                }
+            }
+            uint32_t deferred = 0;
+            if (get<uint8_t>()) {
+                out.program = program(slot_count);
+                deferred = out.program->slot_mask();
+            }
+            if (!ok) {
+                return;
+            }
+
+            // The checks the compiler made: the target and the selector
+            // slots agree, and with id waived for a selection, required
+            // parameters are given, defaults filled and kinds match.
+            uint32_t given = present | deferred;
+            if (signature.selectors) {
+                ok = check_target(*out.schema, given, signature.selectors).success &&
+                     out.selector_slots == (given & signature.selectors);
+            }
+            uint32_t waived = target_waiver(*out.schema, out.selector_slots);
+            ok = ok && out.schema->finalize(out.args, deferred | waived).success;
+        }
+
+        std::shared_ptr<const ExprProgram> program(size_t slot_count) {
+            auto program = std::make_shared<ExprProgram>();
+            uint16_t constants = get<uint16_t>();
+            ok = ok && constants <= ExprProgram::max_registers;
+            for (uint16_t i = 0; i < constants && ok; ++i) {
+                program->initial.push_back(value());
+            }
+            uint16_t instructions = get<uint16_t>();
+            for (uint16_t i = 0; i < instructions && ok; ++i) {
+                auto in = get<ExprProgram::Instruction>();
+                ok = ok && in.op <= ExprOp::Negate && in.target < ExprProgram::max_registers &&
+                     in.lhs < ExprProgram::max_registers && in.rhs < ExprProgram::max_registers;
+                program->code.push_back(in);
+            }
+            uint16_t variables = get<uint16_t>();
+            for (uint16_t i = 0; i < variables && ok; ++i) {
+                program->variables.push_back(symbol());
+            }
+            for (const ExprProgram::Instruction& in : program->code) {
+                ok = ok && (in.op != ExprOp::Variable || in.lhs < program->variables.size());
+            }
+            uint16_t outputs = get<uint16_t>();
+            for (uint16_t i = 0; i < outputs && ok; ++i) {
+                auto output = get<ExprProgram::Output>();
+                ok = ok && output.slot < slot_count && output.source < ExprProgram::max_registers;
+                program->outputs.push_back(output);
+            }
+            return program;
+        }
+
+        std::string text() {
+            MiniValue text = mini_value();
+            ok = ok && std::holds_alternative<std::string>(text);
+            return ok ? std::get<std::string>(std::move(text)) : std::string();
+        }
+    };
+
+    static void fail(CompiledScript& script, const Decoder& decoder, std::string message) {
+        script.commands.clear();
+        script.valid = false;
+        script.error = std::move(message);
+        script.error_offset = sizeof(ScriptImageHeader) + decoder.position;
+    }
+};
+
+/**
+ * @brief Write a compiled script to an image file
+ * @param source_hash hash_script() of the source, checked by callers to
+ * detect stale images
+ * @return false if the script is invalid or the file cannot be written
+ */
+inline bool save_script_image(const CompiledScript& script, const std::string& path,
+                              uint64_t source_hash = 0) {
+    if (!script.valid) {
+        return false;
+    }
+    std::string image = ScriptImageCodec::encode(script, source_hash);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(image.data(), static_cast<std::streamsize>(image.size()));
+    return static_cast<bool>(file);
+}
+
+/**
+ * @brief Map an image file and rebuild its script
+ *
+ * On failure the script is invalid and error says why.
+ */
+inline CompiledScript load_script_image(
+    ScriptCompiler& compiler, const std::string& path,
+    std::pmr::memory_resource* memory = std::pmr::get_default_resource()) {
+    MappedFile file(path);
+    if (!file.is_open()) {
+        CompiledScript script(memory);
+        script.error = "Cannot open script image: " + path;
+        return script;
+    }
+    return ScriptImageCodec::decode(compiler, file.data(), memory);
+}
+
+}  // namespace krayon::mini
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "script_compiler.hpp"
+
+#include <charconv>
+#include <cstddef>
+#include <fstream>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define KRAYON_MINI_HAS_MMAP 1
+#endif
+
+namespace krayon::mini {
+
+/**
+ * @file script_stream.hpp
+ * @brief Incremental compilation of scripts too large to hold in memory
+ *
+ * ScriptStream yields compiled commands one at a time, either from an
+ * std::istream read in bounded chunks or from a memory-mapped file, so
+ * multi-GB command logs can be replayed while they are being parsed.
+ */
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ *
+ * Falls back to reading the file into memory on platforms without mmap.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#if defined(KRAYON_MINI_HAS_MMAP)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        // Only a successful stat and map count as open; a failure must not
+        // read as an empty file.
+        struct stat info {};
+        if (::fstat(fd, &info) == 0) {
+            if (info.st_size == 0) {
+                opened = true;
+            } else {
+                void* mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                                      MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    size = static_cast<size_t>(info.st_size);
+                    ::madvise(mapped, size, MADV_SEQUENTIAL);
+                    address = mapped;
+                    opened = true;
+                }
+            }
+        }
+        ::close(fd);
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (file) {
+            fallback.assign(std::istreambuf_iterator<char>(file), {});
+            opened = !file.bad();
+        }
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(KRAYON_MINI_HAS_MMAP)
+        if (address) {
+            ::munmap(address, size);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() const { return opened; }
+
+    std::string_view data() const {
+#if defined(KRAYON_MINI_HAS_MMAP)
+        return address ? std::string_view(static_cast<const char*>(address), size)
+                       : std::string_view();
+#else
+        return fallback;
+#endif
+    }
+
+private:
+    bool opened = false;
+#if defined(KRAYON_MINI_HAS_MMAP)
+    void* address = nullptr;
+    size_t size = 0;
+#else
+    std::string fallback;
+#endif
+};
+
+/**
+ * @brief Finds statement boundaries in a byte stream fed in pieces
+ *
+ * A statement ends after a ')' or '}' that closes depth 0, or at a ';' at
+ * depth 0, outside strings and comments; parentheses and loop braces both
+ * count toward depth. State carries over between feeds.
+ */
+class StatementSplitter {
+public:
+    /**
+     * @brief Scan data[from, end); return the offset just past the last
+     * boundary found, or npos
+     */
+    size_t feed(std::string_view data, size_t from) {
+        size_t boundary = std::string_view::npos;
+        for (size_t i = from; i < data.size(); ++i) {
+            char c = data[i];
+            if (in_comment) {
+                in_comment = c != '\n';
+            } else if (quote) {
+                if (escaped) {
+                    escaped = false;
+                } else if (c == '\\') {
+                    escaped = true;
+                } else if (c == quote) {
+                    quote = 0;
+                }
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '#') {
+                in_comment = true;
+            } else if (c == '(' || c == '{') {
+                ++depth;
+            } else if (c == ')' || c == '}') {
+                if (depth > 0 && --depth == 0) {
+                    boundary = i + 1;
+                }
+            } else if (c == ';' && depth == 0) {
+                boundary = i + 1;
+            }
+        }
+        return boundary;
+    }
+
+private:
+    char quote = 0;
+    bool escaped = false;
+    bool in_comment = false;
+    size_t depth = 0;
+};
+
+/**
+ * @brief Pull-style compiler over a stream or a mapped file
+ *
+ * For streams, memory stays bounded by the chunk size plus the longest
+ * single statement. Commands are compiled lazily as next() is called, so
+ * a caller that executes each command before pulling the next one
+ * interleaves parsing and execution.
+ */
+class ScriptStream {
+public:
+    ScriptStream(ScriptCompiler& compiler, std::istream& input,
+                 size_t chunk_size = 1 << 20)
+        : compiler(compiler), input(&input), chunk_size(chunk_size) {}
+
+    ScriptStream(ScriptCompiler& compiler, const MappedFile& file)
+        : compiler(compiler), window(file.data()), tokens(std::in_place, window) {}
+
+    /**
+     * @brief Compile the next command
+     * @return false at end of input or on error (see failed())
+     */
+    bool next(CompiledCommand& out) {
+        while (true) {
+            if (tokens) {
+                out = CompiledCommand{};
+                CommandResult status = compiler.compile_next(*tokens, out);
+                if (!status.success) {
+                    error = rebase_message(status.message, base_offset);
+                    error_position = base_offset + tokens->offset();
+                    return false;
+                }
+                if (!out.empty()) {
+                    ++compiled_count;
+                    return true;
+                }
+                tokens.reset();
+            }
+            if (!refill()) {
+                return false;
+            }
+        }
+    }
+
+    bool failed() const { return !error.empty(); }
+    const std::string& get_error() const { return error; }
+
+    /**
+     * @brief Absolute byte offset of the error in the input
+     */
+    size_t error_offset() const { return error_position; }
+
+    size_t commands_compiled() const { return compiled_count; }
+
+private:
+    /**
+     * @brief Make the "at offset N" of a compiler error absolute
+     *
+     * The compiler reports offsets within the current window.
+     */
+    static std::string rebase_message(const std::string& message, size_t base) {
+        constexpr std::string_view marker = " at offset ";
+        size_t at = message.rfind(marker);
+        if (base == 0 || at == std::string::npos) {
+            return message;
+        }
+        size_t offset = 0;
+        const char* first = message.data() + at + marker.size();
+        const char* last = message.data() + message.size();
+        auto [end, ec] = std::from_chars(first, last, offset);
+        if (ec != std::errc() || end != last) {
+            return message;
+        }
+        return message.substr(0, at + marker.size()) + std::to_string(base + offset);
+    }
+
+    ScriptCompiler& compiler;
+    std::istream* input = nullptr;
+    size_t chunk_size = 0;
+    std::string buffer;
+    std::string_view window;
+    std::optional<TokenStream> tokens;
+    StatementSplitter splitter;
+    size_t scanned = 0;      ///< Bytes of buffer already fed to the splitter
+    size_t consumed = 0;     ///< Bytes of buffer already compiled
+    size_t base_offset = 0;  ///< Absolute offset of buffer[0]
+    bool at_eof = false;
+    std::string error;
+    size_t error_position = 0;
+    size_t compiled_count = 0;
+
+    /**
+     * @brief Expose the next run of complete statements as a TokenStream
+     */
+    bool refill() {
+        if (!input || failed()) {
+            return false;
+        }
+
+        // Drop what has been compiled; the splitter state at that point is
+        // "between statements".
+        buffer.erase(0, consumed);
+        base_offset += consumed;
+        scanned -= consumed;
+        consumed = 0;
+
+        while (true) {
+            size_t boundary = splitter.feed(buffer, scanned);
+            scanned = buffer.size();
+            if (boundary != std::string_view::npos) {
+                consumed = boundary;
+                break;
+            }
+            if (at_eof) {
+                if (buffer.empty()) {
+                    return false;
+                }
+                consumed = buffer.size();
+                break;
+            }
+            size_t old_size = buffer.size();
+            buffer.resize(old_size + chunk_size);
+            input->read(buffer.data() + old_size, static_cast<std::streamsize>(chunk_size));
+            buffer.resize(old_size + static_cast<size_t>(input->gcount()));
+            at_eof = !*input;
+        }
+
+        // Anything after the last boundary belongs to a statement that is
+        // still incomplete; it is rescanned after the next read.
+        scanned = consumed;
+        splitter = StatementSplitter();
+        window = std::string_view(buffer).substr(0, consumed);
+        tokens.emplace(window);
+        return true;
+    }
+};
+
+/**
+ * @brief Compile and execute a stream command by command
+ * @param on_result Called with each command's result, in order
+ * @return false if compilation failed; the stream holds the error
+ */
+template<typename ResultFn>
+bool replay(ScriptStream& stream, CommandContext& context, ResultFn&& on_result) {
+    CompiledCommand compiled;
+    while (stream.next(compiled)) {
+        on_result(execute_compiled(compiled, context));
+    }
+    return !stream.failed();
+}
+
+}  // namespace krayon::mini
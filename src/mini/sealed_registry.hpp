@@ -0,0 +1,245 @@
+#pragma once
+
+#include "mini_lang.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file sealed_registry.hpp
+ * @brief Immutable, perfect-hashed command lookup
+ *
+ * CommandRegistry is mutable and hands out shared_ptr copies. Once startup
+ * registration is done it can be sealed into a SealedCommandRegistry whose
+ * lookups are collision-free table probes returning plain SceneCommand
+ * pointers, so the hot path does no refcount traffic. The builtin command
+ * names are hashed by a table generated at compile time.
+ */
+
+/**
+ * @brief Seeded FNV-1a hash used by the perfect-hash tables
+ */
+constexpr uint32_t hash_name(std::string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 15;
+    return hash;
+}
+
+/**
+ * @brief Names of the commands in builtin_commands
+ */
+inline constexpr std::array<std::string_view, 5> builtin_command_names = {
+    "create_element",
+    "delete_element",
+    "set_property",
+    "get_property",
+    "transform"
+};
+
+namespace detail {
+
+constexpr size_t next_power_of_two(size_t n) {
+    size_t size = 1;
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+/**
+ * @brief Single-seed perfect hash over a fixed name set
+ */
+template<size_t N, size_t TableSize = next_power_of_two(N * 2)>
+struct StaticPerfectHash {
+    uint32_t seed = 0;
+    std::array<int, TableSize> slots{};
+
+    constexpr int lookup(const std::array<std::string_view, N>& names,
+                         std::string_view name) const {
+        int index = slots[hash_name(name, seed) & (TableSize - 1)];
+        return index >= 0 && names[static_cast<size_t>(index)] == name ? index : -1;
+    }
+};
+
+template<size_t N>
+constexpr StaticPerfectHash<N> make_static_perfect_hash(
+    const std::array<std::string_view, N>& names) {
+    StaticPerfectHash<N> table;
+    constexpr size_t mask = table.slots.size() - 1;
+    for (uint32_t seed = 0;; ++seed) {
+        table.seed = seed;
+        for (int& slot : table.slots) {
+            slot = -1;
+        }
+        bool collision = false;
+        for (size_t i = 0; i < N && !collision; ++i) {
+            int& slot = table.slots[hash_name(names[i], seed) & mask];
+            collision = slot >= 0;
+            slot = static_cast<int>(i);
+        }
+        if (!collision) {
+            return table;
+        }
+    }
+}
+
+inline constexpr auto builtin_hash = make_static_perfect_hash(builtin_command_names);
+
+}  // namespace detail
+
+/**
+ * @brief Index of a builtin command name in builtin_command_names, or -1
+ */
+constexpr int builtin_command_index(std::string_view name) {
+    return detail::builtin_hash.lookup(builtin_command_names, name);
+}
+
+static_assert(builtin_command_index("transform") == 4);
+static_assert(builtin_command_index("no_such_command") == -1);
+
+/**
+ * @brief Read-only registry with perfect-hash lookups
+ *
+ * Builtin names resolve through the compile-time table; other commands use
+ * a hash-and-displace table built when sealing. The sealed registry keeps
+ * the registered commands alive; pointers it returns are valid for its
+ * lifetime.
+ */
+class SealedCommandRegistry {
+public:
+    SealedCommandRegistry() = default;
+
+    /**
+     * @brief Snapshot the commands currently in a registry
+     */
+    explicit SealedCommandRegistry(const CommandRegistry& registry) {
+        for (const std::string& name : registry.get_all_commands()) {
+            add(registry.get_command(name));
+        }
+        build_dynamic_table();
+    }
+
+    /**
+     * @brief Look up a command by name; nullptr if not registered
+     */
+    SceneCommand* find(std::string_view name) const noexcept {
+        int builtin = builtin_command_index(name);
+        if (builtin >= 0) {
+            return builtins[static_cast<size_t>(builtin)];
+        }
+        if (slots.empty()) {
+            return nullptr;
+        }
+        uint32_t displacement = displacements[hash_name(name, 0) % displacements.size()];
+        const Slot& slot = slots[hash_name(name, displacement) & (slots.size() - 1)];
+        return slot.name == name ? slot.command : nullptr;
+    }
+
+    /**
+     * @brief Look up a command by interned name
+     */
+    SceneCommand* find(SymbolId name) const noexcept {
+        return name < by_symbol.size() ? by_symbol[name] : nullptr;
+    }
+
+    bool has_command(std::string_view name) const noexcept {
+        return find(name) != nullptr;
+    }
+
+    size_t size() const { return owners.size(); }
+
+private:
+    struct Slot {
+        std::string_view name;
+        SceneCommand* command = nullptr;
+    };
+
+    std::array<SceneCommand*, builtin_command_names.size()> builtins{};
+    std::vector<uint32_t> displacements;
+    std::vector<Slot> slots;
+    std::vector<SceneCommand*> by_symbol;
+    std::vector<std::shared_ptr<SceneCommand>> owners;
+
+    void add(std::shared_ptr<SceneCommand> command) {
+        SymbolId id = intern(command->get_name());
+        if (id >= by_symbol.size()) {
+            by_symbol.resize(id + 1, nullptr);
+        }
+        by_symbol[id] = command.get();
+        owners.push_back(std::move(command));
+    }
+
+    void build_dynamic_table() {
+        std::vector<Slot> dynamic;
+        for (const auto& command : owners) {
+            // Names are taken from the symbol table so the views stay valid.
+            std::string_view name = SymbolTable::global().name(intern(command->get_name()));
+            int builtin = builtin_command_index(name);
+            if (builtin >= 0) {
+                builtins[static_cast<size_t>(builtin)] = command.get();
+            } else {
+                dynamic.push_back({name, command.get()});
+            }
+        }
+        if (dynamic.empty()) {
+            return;
+        }
+
+        // Hash and displace: group names into buckets, then place the
+        // largest buckets first, searching a displacement seed per bucket
+        // that maps all of its names to free slots.
+        size_t bucket_count = (dynamic.size() + 3) / 4;
+        displacements.assign(bucket_count, 0);
+        slots.assign(detail::next_power_of_two(dynamic.size() * 2), Slot{});
+        size_t mask = slots.size() - 1;
+
+        std::vector<std::vector<const Slot*>> buckets(bucket_count);
+        for (const Slot& entry : dynamic) {
+            buckets[hash_name(entry.name, 0) % bucket_count].push_back(&entry);
+        }
+        std::vector<size_t> order(bucket_count);
+        for (size_t i = 0; i < bucket_count; ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        std::vector<size_t> placed;
+        for (size_t b : order) {
+            for (uint32_t seed = 1;; ++seed) {
+                placed.clear();
+                bool fits = true;
+                for (const Slot* entry : buckets[b]) {
+                    size_t slot = hash_name(entry->name, seed) & mask;
+                    bool taken = slots[slot].command != nullptr ||
+                                 std::find(placed.begin(), placed.end(), slot) != placed.end();
+                    if (taken) {
+                        fits = false;
+                        break;
+                    }
+                    placed.push_back(slot);
+                }
+                if (fits) {
+                    displacements[b] = seed;
+                    for (size_t i = 0; i < placed.size(); ++i) {
+                        slots[placed[i]] = *buckets[b][i];
+                    }
+                    break;
+                }
+            }
+        }
+    }
+};
+
+}  // namespace krayon::mini
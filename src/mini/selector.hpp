@@ -0,0 +1,309 @@
+#pragma once
+
+#include "command_schema.hpp"
+#include "element_store.hpp"
+#include "sealed_registry.hpp"
+#include "value.hpp"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file selector.hpp
+ * @brief Element selectors for bulk transform and set_property
+ *
+ * Instead of an id, `transform` and `set_property` accept a selector made of
+ * any combination of:
+ *
+ * - `select`: a glob over element ids (`*` any run, `?` one character)
+ * - `tag`: the value of the element's `tag` property
+ * - `min_x` ... `max_z`: an axis-aligned box; missing bounds are open
+ *
+ * Both commands still declare `id` required, so name-keyed callers and
+ * validate_parameters() see the usual schema; the compiler waives it only
+ * when a selector is given (see target_waiver()).
+ *
+ * The literal prefix of the glob is resolved through the store's sorted id
+ * index (or, without an id pattern, the tag through a hash index on `tag`
+ * if there is one), and the remaining conditions filter the candidates
+ * column by column. The operation is then applied as one pass over the
+ * selected rows of the affected columns. Selectors need the context's
+ * ElementStore and only run through compiled scripts; transform supports
+ * `move`.
+ */
+
+/**
+ * @brief Parameters that form a selector, in slot-mask bit order
+ */
+inline constexpr std::array<std::string_view, 8> selector_parameter_names = {
+    "select", "tag", "min_x", "min_y", "min_z", "max_x", "max_y", "max_z"
+};
+
+/**
+ * @brief Does a builtin command accept selectors?
+ */
+inline bool supports_selectors(std::string_view command_name) {
+    return command_name == "transform" || command_name == "set_property";
+}
+
+/**
+ * @brief Slots of the selector parameters in a schema
+ */
+inline uint32_t selector_slot_mask(const CommandSchema& schema) {
+    uint32_t mask = 0;
+    for (std::string_view name : selector_parameter_names) {
+        int slot = schema.slot_of(intern(name));
+        if (slot >= 0) {
+            mask |= uint32_t{1} << slot;
+        }
+    }
+    return mask;
+}
+
+/**
+ * @brief Check that a command names its target exactly one way
+ * @param given Slots with a value, including those computed at execution
+ */
+inline CommandResult check_target(const CommandSchema& schema, uint32_t given,
+                                  uint32_t selector_mask) {
+    int id_slot = schema.slot_of(intern("id"));
+    bool has_id = id_slot >= 0 && ((given >> id_slot) & 1u);
+    bool has_selector = (given & selector_mask) != 0;
+    if (has_id && has_selector) {
+        return CommandResult(false, "Use either id or a selector, not both");
+    }
+    if (!has_id && !has_selector) {
+        return CommandResult(false, "Missing required parameter: id");
+    }
+    return CommandResult(true);
+}
+
+/**
+ * @brief Slot of the required id, which a selector stands in for
+ * @param selector_slots Selector slots given; no waiver when zero
+ */
+inline uint32_t target_waiver(const CommandSchema& schema, uint32_t selector_slots) {
+    int id_slot = schema.slot_of(intern("id"));
+    return selector_slots && id_slot >= 0 ? uint32_t{1} << id_slot : 0;
+}
+
+/**
+ * @brief Match text against a glob with '*' and '?'
+ */
+inline bool glob_match(std::string_view pattern, std::string_view text) {
+    size_t p = 0;
+    size_t t = 0;
+    size_t star = std::string_view::npos;
+    size_t resume = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            ++p;
+            ++t;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            t = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+/**
+ * @brief Conditions an element must meet to be selected
+ */
+struct ElementSelector {
+    std::string pattern;  ///< Id glob; empty matches every id
+    bool has_tag = false;
+    Value tag;
+    bool has_box = false;
+    std::array<double, 3> min{-std::numeric_limits<double>::infinity(),
+                              -std::numeric_limits<double>::infinity(),
+                              -std::numeric_limits<double>::infinity()};
+    std::array<double, 3> max{std::numeric_limits<double>::infinity(),
+                              std::numeric_limits<double>::infinity(),
+                              std::numeric_limits<double>::infinity()};
+
+    /**
+     * @brief Does one element meet every condition?
+     */
+    bool matches(std::string_view id, Value element_tag,
+                 const std::array<double, 3>& position) const {
+        if (!pattern.empty() && !glob_match(pattern, id)) {
+            return false;
+        }
+        if (has_tag && element_tag != tag) {
+            return false;
+        }
+        for (size_t axis = 0; axis < 3; ++axis) {
+            if (position[axis] < min[axis] || position[axis] > max[axis]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Read the selector arguments of a bound command
+     */
+    static ElementSelector from_arguments(const CommandSchema& schema,
+                                          const BoundArguments& args) {
+        ElementSelector selector;
+        auto get = [&](std::string_view name) -> const MiniValue* {
+            int slot = schema.slot_of(intern(name));
+            return slot >= 0 ? args.get(static_cast<size_t>(slot)) : nullptr;
+        };
+        if (const MiniValue* pattern = get("select")) {
+            selector.pattern = std::get<std::string>(*pattern);
+        }
+        if (const MiniValue* tag = get("tag")) {
+            selector.has_tag = true;
+            selector.tag = Value::from_mini(*tag);
+        }
+        for (size_t axis = 0; axis < 3; ++axis) {
+            if (const MiniValue* bound = get(selector_parameter_names[2 + axis])) {
+                selector.min[axis] = std::get<double>(*bound);
+                selector.has_box = true;
+            }
+            if (const MiniValue* bound = get(selector_parameter_names[5 + axis])) {
+                selector.max[axis] = std::get<double>(*bound);
+                selector.has_box = true;
+            }
+        }
+        return selector;
+    }
+};
+
+/**
+ * @brief Rows of the elements a selector matches, in ascending row order
+ */
+inline void select_rows(const ElementStore& store, const ElementSelector& selector,
+                        std::pmr::vector<ElementStore::Row>& rows) {
+    using Row = ElementStore::Row;
+    rows.clear();
+
+    std::string_view pattern = selector.pattern;
+    size_t wildcard = pattern.find_first_of("*?");
+    std::string_view prefix = pattern.substr(0, wildcard);
+    if (!prefix.empty()) {
+        bool exact = wildcard == std::string_view::npos;
+        bool prefix_only = wildcard == pattern.size() - 1 && pattern.back() == '*';
+        for (const ElementStore::NamedRow& entry : store.rows_with_id_prefix(prefix)) {
+            if (prefix_only || (exact ? entry.name.size() == prefix.size()
+                                      : glob_match(pattern, entry.name))) {
+                rows.push_back(entry.row);
+            }
+        }
+        std::sort(rows.begin(), rows.end());
+    } else if (!pattern.empty() && pattern != "*") {
+        for (Row row = 0; row < store.size(); ++row) {
+            if (glob_match(pattern, store.id_at(row))) {
+                rows.push_back(row);
+            }
+        }
+    } else if (selector.has_tag &&
+               store.has_index(intern("tag"), ElementStore::IndexKind::Hash)) {
+        store.rows_equal(intern("tag"), selector.tag, rows);
+    } else {
+        rows.resize(store.size());
+        for (Row row = 0; row < rows.size(); ++row) {
+            rows[row] = row;
+        }
+    }
+
+    if (selector.has_tag) {
+        SymbolId tag = intern("tag");
+        std::erase_if(rows, [&](Row row) { return store.get_property(row, tag) != selector.tag; });
+    }
+    if (selector.has_box) {
+        std::span<const double> x = store.get_x();
+        std::span<const double> y = store.get_y();
+        std::span<const double> z = store.get_z();
+        std::erase_if(rows, [&](Row row) {
+            return x[row] < selector.min[0] || x[row] > selector.max[0] ||
+                   y[row] < selector.min[1] || y[row] > selector.max[1] ||
+                   z[row] < selector.min[2] || z[row] > selector.max[2];
+        });
+    }
+}
+
+/**
+ * @brief Run transform or set_property on every selected element
+ * @return Number of elements changed as the return value
+ */
+inline CommandResult execute_selection(const CompiledCommand& compiled,
+                                       const BoundArguments& args, CommandContext& context) {
+    const auto& store = context.get_element_store();
+    if (!store) {
+        return CommandResult(false, "Selectors need an element store");
+    }
+    const CommandSchema& schema = *compiled.schema;
+    auto get = [&](std::string_view name) -> const MiniValue* {
+        int slot = schema.slot_of(intern(name));
+        return slot >= 0 ? args.get(static_cast<size_t>(slot)) : nullptr;
+    };
+
+    std::pmr::vector<ElementStore::Row> rows(context.get_memory_resource());
+    select_rows(*store, ElementSelector::from_arguments(schema, args), rows);
+
+    if (builtin_command_index(compiled.command->get_name()) ==
+        builtin_command_index("set_property")) {
+        const MiniValue* property = get("property");
+        const MiniValue* value = get("value");
+        if (!property || !value) {
+            return CommandResult(false, "Missing required parameter: " +
+                                            std::string(property ? "value" : "property"));
+        }
+        SymbolId name = intern(std::get<std::string>(*property));
+        Value converted = Value::from_mini(*value);
+        if (store->is_indexed(name)) {
+            for (ElementStore::Row row : rows) {
+                store->set_property(row, name, converted);
+            }
+        } else {
+            std::vector<Value>& column = store->property_column(name);
+            for (ElementStore::Row row : rows) {
+                column[row] = converted;
+            }
+        }
+        return CommandResult(true, "", static_cast<double>(rows.size()));
+    }
+
+    const MiniValue* operation = get("operation");
+    if (!operation || std::get<std::string>(*operation) != "move") {
+        return CommandResult(false, "Selectors only support the 'move' transform");
+    }
+    double delta[3] = {0.0, 0.0, 0.0};
+    const char* axes[3] = {"x", "y", "z"};
+    for (size_t axis = 0; axis < 3; ++axis) {
+        if (const MiniValue* value = get(axes[axis])) {
+            delta[axis] = std::get<double>(*value);
+        }
+    }
+    std::span<double> columns[3] = {store->get_x(), store->get_y(), store->get_z()};
+    for (size_t axis = 0; axis < 3; ++axis) {
+        if (delta[axis] == 0.0) {
+            continue;
+        }
+        double* column = columns[axis].data();
+        for (ElementStore::Row row : rows) {
+            column[row] += delta[axis];
+        }
+    }
+    return CommandResult(true, "", static_cast<double>(rows.size()));
+}
+
+}  // namespace krayon::mini
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KRAYON_MINI_SSE2 1
+#endif
+
+namespace krayon::mini::simd {
+
+/**
+ * @file simd_scan.hpp
+ * @brief Vectorized character classification for the mini language lexer
+ *
+ * The source is processed in aligned 64-byte blocks. Each block is
+ * classified once into per-class bitmasks (bit i set when byte i of the
+ * block belongs to the class), and token boundaries are then located with
+ * count-trailing-zeros on those masks instead of testing bytes one by one.
+ * AVX2 and SSE2 code paths are selected at compile time; other targets use
+ * a portable scalar classifier producing identical masks.
+ */
+
+constexpr size_t block_size = 64;
+
+/**
+ * @brief Character-class bitmasks for one 64-byte block
+ */
+struct BlockMasks {
+    uint64_t whitespace = 0;  ///< ' ', '\t', '\r', '\n'
+    uint64_t identifier = 0;  ///< [A-Za-z0-9_]
+    uint64_t digit = 0;       ///< [0-9]
+    uint64_t quote = 0;       ///< '"' or '\''
+    uint64_t backslash = 0;   ///< '\\'
+};
+
+namespace detail {
+
+inline void classify_scalar(const unsigned char* p, BlockMasks& m) {
+    for (size_t i = 0; i < block_size; ++i) {
+        unsigned char c = p[i];
+        uint64_t bit = uint64_t{1} << i;
+        unsigned char lower = c | 0x20;
+        bool digit = c >= '0' && c <= '9';
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') m.whitespace |= bit;
+        if (digit) m.digit |= bit;
+        if (digit || c == '_' || (lower >= 'a' && lower <= 'z')) m.identifier |= bit;
+        if (c == '"' || c == '\'') m.quote |= bit;
+        if (c == '\\') m.backslash |= bit;
+    }
+}
+
+#if defined(__AVX2__)
+
+inline void classify_avx2(const unsigned char* p, BlockMasks& m) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i zero_m1 = _mm256_set1_epi8('0' - 1);
+    const __m256i nine_p1 = _mm256_set1_epi8('9' + 1);
+    const __m256i a_m1 = _mm256_set1_epi8('a' - 1);
+    const __m256i z_p1 = _mm256_set1_epi8('z' + 1);
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i underscore = _mm256_set1_epi8('_');
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i squote = _mm256_set1_epi8('\'');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+
+    for (size_t half = 0; half < 2; ++half) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + half * 32));
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, zero_m1),
+                                         _mm256_cmpgt_epi8(nine_p1, v));
+        __m256i lower = _mm256_or_si256(v, case_bit);
+        __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, a_m1),
+                                         _mm256_cmpgt_epi8(z_p1, lower));
+        __m256i ident = _mm256_or_si256(_mm256_or_si256(digit, alpha),
+                                        _mm256_cmpeq_epi8(v, underscore));
+        __m256i quote = _mm256_or_si256(_mm256_cmpeq_epi8(v, dquote),
+                                        _mm256_cmpeq_epi8(v, squote));
+        __m256i esc = _mm256_cmpeq_epi8(v, bslash);
+
+        unsigned shift = static_cast<unsigned>(half * 32);
+        auto bits = [](__m256i x) {
+            return static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(x)));
+        };
+        m.whitespace |= bits(ws) << shift;
+        m.digit |= bits(digit) << shift;
+        m.identifier |= bits(ident) << shift;
+        m.quote |= bits(quote) << shift;
+        m.backslash |= bits(esc) << shift;
+    }
+}
+
+#elif defined(KRAYON_MINI_SSE2)
+
+inline void classify_sse2(const unsigned char* p, BlockMasks& m) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i zero_m1 = _mm_set1_epi8('0' - 1);
+    const __m128i nine_p1 = _mm_set1_epi8('9' + 1);
+    const __m128i a_m1 = _mm_set1_epi8('a' - 1);
+    const __m128i z_p1 = _mm_set1_epi8('z' + 1);
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i underscore = _mm_set1_epi8('_');
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i squote = _mm_set1_epi8('\'');
+    const __m128i bslash = _mm_set1_epi8('\\');
+
+    for (size_t quarter = 0; quarter < 4; ++quarter) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + quarter * 16));
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, zero_m1),
+                                      _mm_cmplt_epi8(v, nine_p1));
+        __m128i lower = _mm_or_si128(v, case_bit);
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, a_m1),
+                                      _mm_cmplt_epi8(lower, z_p1));
+        __m128i ident = _mm_or_si128(_mm_or_si128(digit, alpha),
+                                     _mm_cmpeq_epi8(v, underscore));
+        __m128i quote = _mm_or_si128(_mm_cmpeq_epi8(v, dquote),
+                                     _mm_cmpeq_epi8(v, squote));
+        __m128i esc = _mm_cmpeq_epi8(v, bslash);
+
+        unsigned shift = static_cast<unsigned>(quarter * 16);
+        auto bits = [](__m128i x) {
+            return static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(x)));
+        };
+        m.whitespace |= bits(ws) << shift;
+        m.digit |= bits(digit) << shift;
+        m.identifier |= bits(ident) << shift;
+        m.quote |= bits(quote) << shift;
+        m.backslash |= bits(esc) << shift;
+    }
+}
+
+#endif
+
+}  // namespace detail
+
+/**
+ * @brief Classify 64 bytes starting at p into per-class bitmasks
+ */
+inline BlockMasks classify_block(const char* p) {
+    BlockMasks masks;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(p);
+#if defined(__AVX2__)
+    detail::classify_avx2(bytes, masks);
+#elif defined(KRAYON_MINI_SSE2)
+    detail::classify_sse2(bytes, masks);
+#else
+    detail::classify_scalar(bytes, masks);
+#endif
+    return masks;
+}
+
+/**
+ * @brief Block-cached scanner answering "where does this class run end"
+ *
+ * Keeps the masks of the most recently touched block so a token that starts
+ * and ends in the same block costs one classification. The final partial
+ * block is copied into a zero-padded buffer; NUL belongs to no class, so
+ * runs stop at the end of the source.
+ */
+class BlockScanner {
+public:
+    using ClassMask = uint64_t BlockMasks::*;
+
+    explicit BlockScanner(std::string_view source) : source(source) {}
+
+    /**
+     * @brief First offset >= pos whose byte is not in the given class
+     */
+    size_t skip(size_t pos, ClassMask cls) {
+        while (pos < source.size()) {
+            const BlockMasks& m = load(pos);
+            size_t bit = pos - block_start;
+            uint64_t outside = ~(m.*cls) >> bit;
+            if (outside != 0) {
+                return clamp(pos + static_cast<size_t>(std::countr_zero(outside)));
+            }
+            pos = block_start + block_size;
+        }
+        return source.size();
+    }
+
+    /**
+     * @brief First offset >= pos whose byte is in any of the given classes
+     */
+    size_t find(size_t pos, ClassMask first, ClassMask second) {
+        while (pos < source.size()) {
+            const BlockMasks& m = load(pos);
+            size_t bit = pos - block_start;
+            uint64_t hits = ((m.*first) | (m.*second)) >> bit;
+            if (hits != 0) {
+                return clamp(pos + static_cast<size_t>(std::countr_zero(hits)));
+            }
+            pos = block_start + block_size;
+        }
+        return source.size();
+    }
+
+private:
+    std::string_view source;
+    size_t block_start = std::string_view::npos;
+    BlockMasks masks;
+
+    size_t clamp(size_t pos) const { return pos < source.size() ? pos : source.size(); }
+
+    const BlockMasks& load(size_t pos) {
+        size_t start = pos & ~(block_size - 1);
+        if (start == block_start) {
+            return masks;
+        }
+        block_start = start;
+        if (start + block_size <= source.size()) {
+            masks = classify_block(source.data() + start);
+        } else {
+            char padded[block_size] = {};
+            std::memcpy(padded, source.data() + start, source.size() - start);
+            masks = classify_block(padded);
+        }
+        return masks;
+    }
+};
+
+}  // namespace krayon::mini::simd
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file symbol_table.hpp
+ * @brief Interned names for the mini language
+ *
+ * Command names, parameter names and variable names are interned once into
+ * 32-bit symbol ids. Lookups keyed by SymbolId avoid string comparisons and
+ * allocations on the hot path.
+ */
+
+/**
+ * @brief Interned name handle
+ */
+using SymbolId = uint32_t;
+
+/**
+ * @brief Sentinel for "no symbol"
+ */
+inline constexpr SymbolId invalid_symbol = ~SymbolId{0};
+
+/**
+ * @brief Thread-safe intern table mapping names to dense ids
+ *
+ * Ids are assigned sequentially from 0 and never reused, so they can index
+ * arrays directly. Interned strings live as long as the table.
+ */
+class SymbolTable {
+public:
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    /**
+     * @brief The process-wide table used by the parser and registries
+     */
+    static SymbolTable& global() {
+        static SymbolTable table;
+        return table;
+    }
+
+    /**
+     * @brief Get the id for a name, interning it if needed
+     */
+    SymbolId intern(std::string_view name) {
+        {
+            std::shared_lock lock(mutex);
+            auto it = ids.find(name);
+            if (it != ids.end()) {
+                return it->second;
+            }
+        }
+
+        std::unique_lock lock(mutex);
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        auto id = static_cast<SymbolId>(names.size());
+        const std::string& stored = names.emplace_back(name);
+        ids.emplace(stored, id);
+        return id;
+    }
+
+    /**
+     * @brief Get the id for a name without interning it
+     */
+    std::optional<SymbolId> find(std::string_view name) const {
+        std::shared_lock lock(mutex);
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Get the name of an interned symbol
+     */
+    std::string_view name(SymbolId id) const {
+        std::shared_lock lock(mutex);
+        return id < names.size() ? std::string_view(names[id]) : std::string_view();
+    }
+
+    /**
+     * @brief Number of interned symbols
+     */
+    size_t size() const {
+        std::shared_lock lock(mutex);
+        return names.size();
+    }
+
+private:
+    mutable std::shared_mutex mutex;
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, SymbolId> ids;
+};
+
+/**
+ * @brief Intern a name in the global symbol table
+ */
+inline SymbolId intern(std::string_view name) {
+    return SymbolTable::global().intern(name);
+}
+
+/**
+ * @brief Flat open-addressing map keyed by SymbolId
+ *
+ * Linear probing over a power-of-two table with backward-shift deletion, so
+ * there are no tombstones and no per-node allocations.
+ */
+template<typename T>
+class SymbolMap {
+public:
+    SymbolMap() = default;
+
+    /**
+     * @brief Insert or overwrite the value for a key
+     */
+    T& insert_or_assign(SymbolId key, T value) {
+        if ((count + 1) * 4 > slots.size() * 3) {
+            grow();
+        }
+        size_t i = probe(key);
+        if (slots[i].key == invalid_symbol) {
+            slots[i].key = key;
+            ++count;
+        }
+        slots[i].value = std::move(value);
+        return slots[i].value;
+    }
+
+    /**
+     * @brief Find the value for a key, or nullptr
+     */
+    T* find(SymbolId key) {
+        if (slots.empty()) {
+            return nullptr;
+        }
+        Slot& slot = slots[probe(key)];
+        return slot.key == key ? &slot.value : nullptr;
+    }
+
+    const T* find(SymbolId key) const {
+        return const_cast<SymbolMap*>(this)->find(key);
+    }
+
+    bool contains(SymbolId key) const { return find(key) != nullptr; }
+
+    /**
+     * @brief Remove a key; returns whether it was present
+     */
+    bool erase(SymbolId key) {
+        if (slots.empty()) {
+            return false;
+        }
+        size_t hole = probe(key);
+        if (slots[hole].key != key) {
+            return false;
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t next = (hole + 1) & mask; slots[next].key != invalid_symbol;
+             next = (next + 1) & mask) {
+            size_t home = bucket(slots[next].key);
+            // Move the entry back if the hole lies on its probe path.
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                slots[hole] = std::move(slots[next]);
+                hole = next;
+            }
+        }
+        slots[hole] = Slot{};
+        --count;
+        return true;
+    }
+
+    void clear() {
+        slots.clear();
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    /**
+     * @brief Visit every (key, value) pair in unspecified order
+     */
+    template<typename Fn>
+    void for_each(Fn&& fn) const {
+        for (const Slot& slot : slots) {
+            if (slot.key != invalid_symbol) {
+                fn(slot.key, slot.value);
+            }
+        }
+    }
+
+    template<typename Fn>
+    void for_each(Fn&& fn) {
+        for (Slot& slot : slots) {
+            if (slot.key != invalid_symbol) {
+                fn(slot.key, slot.value);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        SymbolId key = invalid_symbol;
+        T value{};
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+
+    size_t bucket(SymbolId key) const {
+        // Multiplicative hashing scatters sequential ids across the table.
+        return static_cast<size_t>(key * 0x9E3779B1u) & (slots.size() - 1);
+    }
+
+    size_t probe(SymbolId key) const {
+        size_t mask = slots.size() - 1;
+        size_t i = bucket(key);
+        while (slots[i].key != invalid_symbol && slots[i].key != key) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    void grow() {
+        std::vector<Slot> old = std::move(slots);
+        slots = std::vector<Slot>(old.empty() ? 8 : old.size() * 2);
+        for (Slot& slot : old) {
+            if (slot.key != invalid_symbol) {
+                slots[probe(slot.key)] = std::move(slot);
+            }
+        }
+    }
+};
+
+}  // namespace krayon::mini
@@ -0,0 +1,320 @@
+#pragma once
+
+#include "mini_lang.hpp"
+#include "simd_scan.hpp"
+
+#include <cctype>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace krayon::mini {
+
+/**
+ * @file token_stream.hpp
+ * @brief Zero-copy, pull-style tokenizer for the mini language
+ *
+ * Unlike Tokenizer::tokenize, which materializes a vector of tokens that each
+ * own a std::string, TokenStream scans the source lazily and hands out views
+ * into the original buffer. The source must outlive every TokenView produced
+ * from it. String literal escapes are left undecoded until decode_string()
+ * is called. Whitespace, identifier, number and string runs are located with
+ * the block bitmasks from simd_scan.hpp rather than byte-at-a-time loops.
+ */
+
+/**
+ * @brief Non-owning token referring to a span of the source buffer
+ *
+ * For String tokens the span covers the literal contents without the
+ * surrounding quotes, still in escaped form.
+ */
+struct TokenView {
+    Tokenizer::TokenType type = Tokenizer::TokenType::End;
+    std::string_view text;
+    size_t position = 0;
+    bool has_escapes = false;  ///< String literal contains backslash escapes
+
+    /**
+     * @brief Convert to an owning Tokenizer::Token (decodes strings)
+     */
+    Tokenizer::Token to_token() const;
+};
+
+/**
+ * @brief Decode the escape sequences of a String token
+ *
+ * Supports \n, \t, \r, \0, \\, \" and \'. Unknown escapes keep the escaped
+ * character verbatim.
+ */
+inline std::string decode_string(const TokenView& token) {
+    if (!token.has_escapes) {
+        return std::string(token.text);
+    }
+
+    std::string out;
+    out.reserve(token.text.size());
+    for (size_t i = 0; i < token.text.size(); ++i) {
+        char c = token.text[i];
+        if (c != '\\' || i + 1 == token.text.size()) {
+            out.push_back(c);
+            continue;
+        }
+        switch (token.text[++i]) {
+            case 'n': out.push_back('\n'); break;
+            case 't': out.push_back('\t'); break;
+            case 'r': out.push_back('\r'); break;
+            case '0': out.push_back('\0'); break;
+            default: out.push_back(token.text[i]); break;
+        }
+    }
+    return out;
+}
+
+inline Tokenizer::Token TokenView::to_token() const {
+    Tokenizer::Token token;
+    token.type = type;
+    token.value = type == Tokenizer::TokenType::String ? decode_string(*this)
+                                                       : std::string(text);
+    token.position = position;
+    return token;
+}
+
+/**
+ * @brief Lazy tokenizer over a borrowed source buffer
+ *
+ * Tokens are produced one at a time by next(); peek() scans ahead without
+ * consuming. Malformed input (an unterminated string or an unexpected
+ * character) ends the stream and sets failed().
+ */
+class TokenStream {
+public:
+    using TokenType = Tokenizer::TokenType;
+
+    explicit TokenStream(std::string_view source) : source(source), scanner(source) {}
+
+    /**
+     * @brief Consume and return the next token
+     */
+    TokenView next() {
+        if (has_lookahead) {
+            has_lookahead = false;
+            return lookahead;
+        }
+        return scan();
+    }
+
+    /**
+     * @brief Return the next token without consuming it
+     */
+    const TokenView& peek() {
+        if (!has_lookahead) {
+            lookahead = scan();
+            has_lookahead = true;
+        }
+        return lookahead;
+    }
+
+    /**
+     * @brief Check whether the stream stopped on malformed input
+     */
+    bool failed() const { return error_position != std::string_view::npos; }
+
+    /**
+     * @brief Offset of the malformed input, or npos
+     */
+    size_t error_offset() const { return error_position; }
+
+    /**
+     * @brief Offset of the next unscanned byte
+     */
+    size_t offset() const { return has_lookahead ? lookahead.position : cursor; }
+
+    /**
+     * @brief The source buffer being tokenized
+     */
+    std::string_view get_source() const { return source; }
+
+    /**
+     * @brief Input iterator over the remaining tokens (End is not yielded)
+     */
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = TokenView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const TokenView*;
+        using reference = const TokenView&;
+
+        iterator() = default;
+        explicit iterator(TokenStream* stream) : stream(stream) { ++*this; }
+
+        reference operator*() const { return current; }
+        pointer operator->() const { return &current; }
+
+        iterator& operator++() {
+            current = stream->next();
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const {
+            return current.type == TokenType::End;
+        }
+
+    private:
+        TokenStream* stream = nullptr;
+        TokenView current;
+    };
+
+    iterator begin() { return iterator(this); }
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    std::string_view source;
+    simd::BlockScanner scanner;
+    size_t cursor = 0;
+    size_t error_position = std::string_view::npos;
+    TokenView lookahead;
+    bool has_lookahead = false;
+
+    static bool is_identifier_start(char c) {
+        return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    static TokenType keyword_or_identifier(std::string_view text) {
+        if (text == "true" || text == "false" || text == "null" ||
+            text == "for" || text == "in") {
+            return TokenType::Keyword;
+        }
+        return TokenType::Identifier;
+    }
+
+    TokenView make(TokenType type, size_t start, size_t length) {
+        cursor = start + length;
+        return {type, source.substr(start, length), start, false};
+    }
+
+    TokenView fail(size_t at) {
+        error_position = at;
+        cursor = source.size();
+        return {TokenType::End, {}, at, false};
+    }
+
+    void skip_whitespace_and_comments() {
+        while (cursor < source.size()) {
+            char c = source[cursor];
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                cursor = scanner.skip(cursor, &simd::BlockMasks::whitespace);
+            } else if (c == '#') {
+                size_t eol = source.find('\n', cursor);
+                cursor = eol == std::string_view::npos ? source.size() : eol + 1;
+            } else {
+                break;
+            }
+        }
+    }
+
+    size_t scan_digits(size_t pos) {
+        return scanner.skip(pos, &simd::BlockMasks::digit);
+    }
+
+    TokenView scan_number(size_t start) {
+        size_t pos = scan_digits(start);
+        // "0..10" is a range, not the literal "0." followed by ".10".
+        if (pos < source.size() && source[pos] == '.' &&
+            !(pos + 1 < source.size() && source[pos + 1] == '.')) {
+            pos = scan_digits(pos + 1);
+        }
+        if (pos < source.size() && (source[pos] == 'e' || source[pos] == 'E')) {
+            size_t exp = pos + 1;
+            if (exp < source.size() && (source[exp] == '+' || source[exp] == '-')) {
+                ++exp;
+            }
+            if (exp < source.size() && is_digit(source[exp])) {
+                pos = scan_digits(exp);
+            }
+        }
+        return make(TokenType::Number, start, pos - start);
+    }
+
+    TokenView scan_string(size_t start) {
+        char quote = source[start];
+        bool escapes = false;
+        for (size_t pos = start + 1; pos < source.size(); ++pos) {
+            pos = scanner.find(pos, &simd::BlockMasks::quote, &simd::BlockMasks::backslash);
+            if (pos >= source.size()) {
+                break;
+            }
+            char c = source[pos];
+            if (c == '\\') {
+                escapes = true;
+                ++pos;
+            } else if (c == quote) {
+                cursor = pos + 1;
+                return {TokenType::String, source.substr(start + 1, pos - start - 1),
+                        start, escapes};
+            }
+        }
+        return fail(start);
+    }
+
+    TokenView scan() {
+        skip_whitespace_and_comments();
+        if (cursor >= source.size()) {
+            return {TokenType::End, {}, source.size(), false};
+        }
+
+        size_t start = cursor;
+        char c = source[start];
+
+        if (is_identifier_start(c)) {
+            size_t pos = scanner.skip(start + 1, &simd::BlockMasks::identifier);
+            TokenView token = make(TokenType::Identifier, start, pos - start);
+            token.type = keyword_or_identifier(token.text);
+            return token;
+        }
+        if (is_digit(c) ||
+            (c == '.' && start + 1 < source.size() && is_digit(source[start + 1]))) {
+            return scan_number(start);
+        }
+
+        switch (c) {
+            case '"':
+            case '\'': return scan_string(start);
+            case '(': return make(TokenType::OpenParen, start, 1);
+            case ')': return make(TokenType::CloseParen, start, 1);
+            case '{': return make(TokenType::OpenBrace, start, 1);
+            case '}': return make(TokenType::CloseBrace, start, 1);
+            case ',': return make(TokenType::Comma, start, 1);
+            case ':': return make(TokenType::Colon, start, 1);
+            case '=': return make(TokenType::Equals, start, 1);
+            case ';': return make(TokenType::Semicolon, start, 1);
+            case '+': return make(TokenType::Plus, start, 1);
+            case '*': return make(TokenType::Multiply, start, 1);
+            case '/': return make(TokenType::Divide, start, 1);
+            case '.':
+                if (start + 1 < source.size() && source[start + 1] == '.') {
+                    return make(TokenType::Range, start, 2);
+                }
+                return fail(start);
+            case '-':
+                if (start + 1 < source.size() && source[start + 1] == '>') {
+                    return make(TokenType::Arrow, start, 2);
+                }
+                return make(TokenType::Minus, start, 1);
+            default: return fail(start);
+        }
+    }
+};
+
+/**
+ * @brief Create a lazy token stream over a borrowed buffer
+ */
+inline TokenStream tokenize_view(std::string_view input) {
+    return TokenStream(input);
+}
+
+}  // namespace krayon::mini
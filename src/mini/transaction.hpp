@@ -0,0 +1,446 @@
+#pragma once
+
+#include "builtin_commands.hpp"
+#include "command_schema.hpp"
+#include "element_store.hpp"
+#include "sealed_registry.hpp"
+#include "selector.hpp"
+#include "value.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace krayon::mini {
+
+/**
+ * @file transaction.hpp
+ * @brief Buffered element changes between `begin` and `commit`
+ *
+ *     begin()
+ *     for i in 0..10000 { create_element(type: "node", name: "n" + i) }
+ *     set_property(select: "n*", property: "color", value: "red")
+ *     commit()
+ *
+ * While a transaction is open, the create_element, delete_element,
+ * set_property and transform commands of compiled scripts are appended to
+ * the context's WriteLog instead of changing the ElementStore. Arguments
+ * are resolved when the command is recorded, and reads see the store as
+ * it was at `begin`; transform only supports `move`.
+ *
+ * `commit` first replays the log against the ids in the store, so an
+ * entry that would fail (a duplicate id, a missing element) aborts the
+ * whole transaction and nothing is applied. Selectors are resolved during
+ * this replay against the elements, tags and positions as they stand at
+ * that point of the transaction, so the selector above matches the
+ * elements the loop creates. It then applies the net effect: removals,
+ * creations in one reserved pass, property writes grouped by property and
+ * sorted by row with one index update per property, and moves sorted by
+ * row. `abort` just drops the log.
+ */
+
+/**
+ * @brief Element changes recorded by an open transaction
+ *
+ * Recording is thread-safe, so independent commands of a transaction may
+ * run on the parallel executor.
+ */
+class WriteLog {
+public:
+    enum class Op : uint8_t {
+        Create,
+        Delete,
+        SetProperty,
+        Move
+    };
+
+    struct Entry {
+        Op op = Op::Create;
+        std::string id;
+        SymbolId name = invalid_symbol;  ///< Type for Create, property for SetProperty
+        Value value;                     ///< Property value
+        double x = 0.0;                  ///< Position for Create, offset for Move
+        double y = 0.0;
+        double z = 0.0;
+        std::shared_ptr<const ElementSelector> selector;  ///< Targets instead of id, if set
+    };
+
+    /**
+     * @brief Is this one of the commands a transaction buffers?
+     */
+    static bool buffers(const CompiledCommand& compiled) {
+        int index = builtin_commands::builtin_index_of(*compiled.command);
+        return index >= 0 && index != builtin_command_index("get_property");
+    }
+
+    /**
+     * @brief Append the changes of a buffered command
+     *
+     * A selection is recorded as one entry and resolved by commit().
+     */
+    CommandResult record(const CompiledCommand& compiled, const BoundArguments& args) {
+        const CommandSchema& schema = *compiled.schema;
+        auto get = [&](std::string_view name) -> const MiniValue* {
+            int slot = schema.slot_of(intern(name));
+            return slot >= 0 ? args.get(static_cast<size_t>(slot)) : nullptr;
+        };
+        auto symbol = [&](std::string_view name) {
+            const MiniValue* value = get(name);
+            return value ? intern(std::get<std::string>(*value)) : invalid_symbol;
+        };
+        auto text = [&](std::string_view name) {
+            const MiniValue* value = get(name);
+            return value ? std::get<std::string>(*value) : std::string();
+        };
+        auto number = [&](std::string_view name) {
+            const MiniValue* value = get(name);
+            return value ? std::get<double>(*value) : 0.0;
+        };
+
+        Entry entry;
+        int index = builtin_commands::builtin_index_of(*compiled.command);
+        if (index == builtin_command_index("create_element")) {
+            entry.op = Op::Create;
+            entry.id = text("name");
+            entry.name = symbol("type");
+            entry.x = number("x");
+            entry.y = number("y");
+        } else if (index == builtin_command_index("delete_element")) {
+            entry.op = Op::Delete;
+            entry.id = text("id");
+        } else if (index == builtin_command_index("set_property")) {
+            entry.op = Op::SetProperty;
+            entry.id = text("id");
+            entry.name = symbol("property");
+            entry.value = Value::from_mini(*get("value"));
+        } else {
+            const MiniValue* operation = get("operation");
+            if (!operation || std::get<std::string>(*operation) != "move") {
+                return CommandResult(false, "Only 'move' transforms can run in a transaction");
+            }
+            entry.op = Op::Move;
+            entry.id = text("id");
+            entry.x = number("x");
+            entry.y = number("y");
+            entry.z = number("z");
+        }
+
+        if (compiled.selector_slots) {
+            entry.selector = std::make_shared<const ElementSelector>(
+                ElementSelector::from_arguments(schema, args));
+        }
+        std::lock_guard lock(mutex);
+        entries.push_back(entry);
+        return CommandResult(true);
+    }
+
+    size_t size() const {
+        std::lock_guard lock(mutex);
+        return entries.size();
+    }
+
+    void clear() {
+        std::lock_guard lock(mutex);
+        entries.clear();
+    }
+
+    /**
+     * @brief Apply every recorded change, or none if any would fail
+     *
+     * The log is empty afterwards either way.
+     * @return The number of element changes, counting each element a
+     * selection matched, as the return value
+     */
+    CommandResult commit(ElementStore& store) {
+        std::lock_guard lock(mutex);
+        std::vector<Entry> log = std::move(entries);
+        entries.clear();
+
+        // Net effect per element. A create or delete starts a new
+        // generation; property writes of earlier generations are dropped.
+        // x, y and z are the position of a created element and the offset
+        // of one that existed.
+        struct State {
+            std::string_view id;  ///< Views into log or selected_ids
+            bool existed;
+            bool alive;
+            bool created = false;
+            uint32_t generation = 0;
+            SymbolId type = invalid_symbol;
+            double x = 0.0;
+            double y = 0.0;
+            double z = 0.0;
+            bool tagged = false;  ///< tag written in this generation
+            Value tag{};
+        };
+        struct Write {
+            SymbolId property;
+            uint32_t state;
+            uint32_t generation;
+            uint32_t sequence;
+            Value value;
+        };
+        std::vector<State> states;
+        std::unordered_map<std::string_view, uint32_t> state_of;
+        std::deque<std::string> selected_ids;  ///< Ids of states added by selections
+        std::vector<Write> writes;
+        size_t changes = 0;
+        const SymbolId tag = intern("tag");
+
+        auto state_for = [&](std::string_view id) {
+            auto [found, added] = state_of.try_emplace(id, static_cast<uint32_t>(states.size()));
+            if (added) {
+                bool existed = store.contains(id);
+                states.push_back({.id = id, .existed = existed, .alive = existed});
+            }
+            return found->second;
+        };
+        auto apply = [&](const Entry& entry, uint32_t index, uint32_t sequence) {
+            State& state = states[index];
+            ++changes;
+            switch (entry.op) {
+                case Op::Create:
+                    state = {.id = state.id,
+                             .existed = state.existed,
+                             .alive = true,
+                             .created = true,
+                             .generation = state.generation + 1,
+                             .type = entry.name,
+                             .x = entry.x,
+                             .y = entry.y,
+                             .z = entry.z};
+                    break;
+                case Op::Delete:
+                    state = {.id = state.id,
+                             .existed = state.existed,
+                             .alive = false,
+                             .generation = state.generation + 1};
+                    break;
+                case Op::SetProperty:
+                    writes.push_back({entry.name, index, state.generation, sequence, entry.value});
+                    if (entry.name == tag) {
+                        state.tagged = true;
+                        state.tag = entry.value;
+                    }
+                    break;
+                case Op::Move:
+                    state.x += entry.x;
+                    state.y += entry.y;
+                    state.z += entry.z;
+                    break;
+            }
+        };
+        // Elements the selector matches at this point of the log: touched
+        // ones by their state, untouched ones as the store has them.
+        std::vector<uint32_t> matched;
+        std::pmr::vector<ElementStore::Row> rows;
+        auto select = [&](const ElementSelector& selector) {
+            matched.clear();
+            for (uint32_t index = 0; index < states.size(); ++index) {
+                const State& state = states[index];
+                if (!state.alive) {
+                    continue;
+                }
+                std::array<double, 3> position{state.x, state.y, state.z};
+                Value value = state.tagged ? state.tag : Value();
+                if (!state.created) {
+                    ElementStore::Row row = store.find(state.id);
+                    position[0] += store.get_x()[row];
+                    position[1] += store.get_y()[row];
+                    position[2] += store.get_z()[row];
+                    if (!state.tagged) {
+                        value = store.get_property(row, tag);
+                    }
+                }
+                if (selector.matches(state.id, value, position)) {
+                    matched.push_back(index);
+                }
+            }
+            select_rows(store, selector, rows);
+            for (ElementStore::Row row : rows) {
+                if (!state_of.contains(store.id_at(row))) {
+                    matched.push_back(state_for(selected_ids.emplace_back(store.id_at(row))));
+                }
+            }
+        };
+
+        for (uint32_t sequence = 0; sequence < log.size(); ++sequence) {
+            const Entry& entry = log[sequence];
+            if (entry.selector) {
+                select(*entry.selector);
+                for (uint32_t index : matched) {
+                    apply(entry, index, sequence);
+                }
+                continue;
+            }
+            uint32_t index = state_for(entry.id);
+            const State& state = states[index];
+            if (entry.op == Op::Create ? state.alive : !state.alive) {
+                return CommandResult(
+                    false, std::string("Transaction aborted: ") +
+                               (state.alive ? "Element already exists: " : "Element not found: ") +
+                               entry.id);
+            }
+            apply(entry, index, sequence);
+        }
+
+        size_t created = 0;
+        for (const State& state : states) {
+            if (state.existed && state.generation > 0) {
+                store.remove(state.id);
+            }
+            created += state.alive && state.created;
+        }
+        store.reserve(store.size() + created);
+        for (const State& state : states) {
+            if (state.alive && state.created) {
+                store.create(state.id, state.type, state.x, state.y, state.z);
+            }
+        }
+
+        std::erase_if(writes, [&](const Write& write) {
+            const State& state = states[write.state];
+            return !state.alive || write.generation != state.generation;
+        });
+        struct RowWrite {
+            SymbolId property;
+            ElementStore::Row row;
+            uint32_t sequence;
+            Value value;
+        };
+        std::vector<RowWrite> row_writes;
+        row_writes.reserve(writes.size());
+        for (const Write& write : writes) {
+            row_writes.push_back({write.property, store.find(states[write.state].id),
+                                  write.sequence, write.value});
+        }
+        std::sort(row_writes.begin(), row_writes.end(), [](const RowWrite& a, const RowWrite& b) {
+            if (a.property != b.property) return a.property < b.property;
+            if (a.row != b.row) return a.row < b.row;
+            return a.sequence < b.sequence;
+        });
+        std::vector<ElementStore::RowValue> batch;
+        for (size_t i = 0; i < row_writes.size(); ++i) {
+            const RowWrite& write = row_writes[i];
+            bool last_of_row = i + 1 == row_writes.size() ||
+                               row_writes[i + 1].property != write.property ||
+                               row_writes[i + 1].row != write.row;
+            if (last_of_row) {
+                batch.push_back({write.row, write.value});
+            }
+            if (i + 1 == row_writes.size() || row_writes[i + 1].property != write.property) {
+                store.set_properties(write.property, batch);
+                batch.clear();
+            }
+        }
+
+        std::vector<std::pair<ElementStore::Row, const State*>> moves;
+        for (const State& state : states) {
+            if (state.alive && !state.created && (state.x != 0.0 || state.y != 0.0 || state.z != 0.0)) {
+                moves.emplace_back(store.find(state.id), &state);
+            }
+        }
+        std::sort(moves.begin(), moves.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (const auto& [row, state] : moves) {
+            store.translate(row, state->x, state->y, state->z);
+        }
+        return CommandResult(true, "", static_cast<double>(changes));
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<Entry> entries;
+};
+
+namespace builtin_commands {
+
+/**
+ * @brief Command to open a transaction
+ */
+class BeginCommand : public SceneCommand {
+public:
+    std::string get_name() const override { return "begin"; }
+
+    std::string get_description() const override {
+        return "Buffer element changes until commit or abort";
+    }
+
+    std::vector<Parameter> get_parameters() const override { return {}; }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        (void)params;
+        if (!context.get_element_store()) {
+            return CommandResult(false, "Transactions need an element store");
+        }
+        if (context.get_write_log()) {
+            return CommandResult(false, "A transaction is already open");
+        }
+        context.set_write_log(std::make_shared<WriteLog>());
+        return CommandResult(true);
+    }
+};
+
+/**
+ * @brief Command to apply the open transaction
+ */
+class CommitCommand : public SceneCommand {
+public:
+    std::string get_name() const override { return "commit"; }
+
+    std::string get_description() const override {
+        return "Apply the element changes buffered since begin";
+    }
+
+    std::vector<Parameter> get_parameters() const override { return {}; }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        (void)params;
+        std::shared_ptr<WriteLog> log = context.get_write_log();
+        if (!log) {
+            return CommandResult(false, "No transaction is open");
+        }
+        context.set_write_log(nullptr);
+        return log->commit(*context.get_element_store());
+    }
+};
+
+/**
+ * @brief Command to discard the open transaction
+ */
+class AbortCommand : public SceneCommand {
+public:
+    std::string get_name() const override { return "abort"; }
+
+    std::string get_description() const override {
+        return "Discard the element changes buffered since begin";
+    }
+
+    std::vector<Parameter> get_parameters() const override { return {}; }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        (void)params;
+        std::shared_ptr<WriteLog> log = context.get_write_log();
+        if (!log) {
+            return CommandResult(false, "No transaction is open");
+        }
+        context.set_write_log(nullptr);
+        return CommandResult(true, "", static_cast<double>(log->size()));
+    }
+};
+
+}  // namespace builtin_commands
+
+}  // namespace krayon::mini
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "mini_lang.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+
+namespace krayon::mini {
+
+/**
+ * @file value.hpp
+ * @brief 8-byte NaN-boxed counterpart of MiniValue
+ *
+ * Doubles are stored as their IEEE-754 bit pattern. Every NaN is
+ * canonicalized to the positive quiet NaN, which frees the negative quiet
+ * NaN space for tagged payloads:
+ *
+ *     0xFFF9'0000'0000'0000            null
+ *     0xFFFA'0000'0000'000b            bool (b = 0 or 1)
+ *     0xFFFB'0000'iiii'iiii            string, interned SymbolId i
+ *
+ * Strings are interned in the global SymbolTable, so conversion to and
+ * from MiniValue is lossless and copying a Value never allocates.
+ */
+class Value {
+public:
+    /**
+     * @brief Default-constructed values are null
+     */
+    constexpr Value() noexcept : bits(null_tag) {}
+
+    static constexpr Value null() noexcept { return Value(); }
+
+    static Value number(double value) noexcept {
+        if (value != value) {
+            return Value(canonical_nan);
+        }
+        return Value(std::bit_cast<uint64_t>(value));
+    }
+
+    static constexpr Value boolean(bool value) noexcept {
+        return Value(bool_tag | static_cast<uint64_t>(value));
+    }
+
+    static constexpr Value symbol(SymbolId id) noexcept {
+        return Value(string_tag | id);
+    }
+
+    static Value string(std::string_view value) {
+        return symbol(intern(value));
+    }
+
+    /**
+     * @brief Convert from MiniValue (interns strings)
+     */
+    static Value from_mini(const MiniValue& value) {
+        switch (value.index()) {
+            case 1: return number(std::get<double>(value));
+            case 2: return string(std::get<std::string>(value));
+            case 3: return boolean(std::get<bool>(value));
+            default: return null();
+        }
+    }
+
+    /**
+     * @brief Convert back to MiniValue
+     */
+    MiniValue to_mini() const {
+        if (is_number()) return as_number();
+        if (is_bool()) return as_bool();
+        if (is_string()) return std::string(as_string());
+        return std::monostate();
+    }
+
+    constexpr bool is_null() const noexcept { return bits == null_tag; }
+    constexpr bool is_bool() const noexcept { return (bits & tag_mask) == bool_tag; }
+    constexpr bool is_string() const noexcept { return (bits & tag_mask) == string_tag; }
+    constexpr bool is_number() const noexcept {
+        uint64_t tag = bits & tag_mask;
+        return tag != null_tag && tag != bool_tag && tag != string_tag;
+    }
+
+    double as_number() const noexcept { return std::bit_cast<double>(bits); }
+    constexpr bool as_bool() const noexcept { return (bits & 1u) != 0; }
+    constexpr SymbolId as_symbol() const noexcept { return static_cast<SymbolId>(bits); }
+    std::string_view as_string() const { return SymbolTable::global().name(as_symbol()); }
+
+    /**
+     * @brief Raw encoding, e.g. for serialization or hashing
+     */
+    constexpr uint64_t raw() const noexcept { return bits; }
+    static constexpr Value from_raw(uint64_t raw) noexcept { return Value(raw); }
+
+    /**
+     * @brief Bitwise equality; numbers compare by value except NaN == NaN
+     * and 0.0 != -0.0
+     */
+    constexpr bool operator==(const Value& other) const noexcept = default;
+
+private:
+    static constexpr uint64_t tag_mask = 0xFFFF'0000'0000'0000ull;
+    static constexpr uint64_t null_tag = 0xFFF9'0000'0000'0000ull;
+    static constexpr uint64_t bool_tag = 0xFFFA'0000'0000'0000ull;
+    static constexpr uint64_t string_tag = 0xFFFB'0000'0000'0000ull;
+    static constexpr uint64_t canonical_nan = 0x7FF8'0000'0000'0000ull;
+
+    uint64_t bits;
+
+    explicit constexpr Value(uint64_t bits) noexcept : bits(bits) {}
+};
+
+static_assert(sizeof(Value) == 8);
+
+// ValueConverter overloads for Value. Numbers and bools take the direct
+// path; everything else goes through the MiniValue conversions so both
+// representations convert identically.
+
+inline std::string ValueConverter::to_string(Value value) {
+    if (value.is_string()) {
+        return std::string(value.as_string());
+    }
+    return to_string(value.to_mini());
+}
+
+inline std::optional<double> ValueConverter::to_number(Value value) {
+    if (value.is_number()) {
+        return value.as_number();
+    }
+    return to_number(value.to_mini());
+}
+
+inline std::optional<bool> ValueConverter::to_bool(Value value) {
+    if (value.is_bool()) {
+        return value.as_bool();
+    }
+    return to_bool(value.to_mini());
+}
+
+inline std::string ValueConverter::get_type_name(Value value) {
+    return get_type_name(value.to_mini());
+}
+
+inline bool ValueConverter::matches_type(Value value, const std::string& type) {
+    if (type == "any") return true;
+    if (type == "number") return value.is_number();
+    if (type == "string") return value.is_string();
+    if (type == "bool") return value.is_bool();
+    return matches_type(value.to_mini(), type);
+}
+
+inline Value ValueConverter::from_string_value(std::string_view value) {
+    return Value::string(value);
+}
+
+inline Value ValueConverter::from_number_value(double value) { return Value::number(value); }
+
+inline Value ValueConverter::from_bool_value(bool value) { return Value::boolean(value); }
+
+}  // namespace krayon::mini
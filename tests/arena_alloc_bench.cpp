@@ -0,0 +1,164 @@
+// Counts the heap allocations made per command when a batch is compiled and
+// run on the global heap, and when it runs through execute_batch_in_arena(),
+// and checks that the arena takes over part of them.
+//
+//     arena_alloc_bench [batches]    (default 1000)
+//
+// Strings bound into arguments and result messages are std::string, so they
+// stay on the heap either way; the arena takes the compiled commands, their
+// expression programs, the compile scratch and the per-command scratch
+// (expression strings, selected rows, loop columns).
+
+#include "mini/builtin_commands.hpp"
+#include "mini/property_query.hpp"
+#include "mini/script_arena.hpp"
+#include "mini/script_compiler.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+size_t heap_allocations = 0;
+
+}  // namespace
+
+// The replacements are not inlined, so GCC does not pair free() with a new
+// expression at the call sites.
+[[gnu::noinline]] void* operator new(size_t size) {
+    ++heap_allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void* operator new(size_t size, std::align_val_t alignment) {
+    ++heap_allocations;
+    size_t align = static_cast<size_t>(alignment);
+    if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+using namespace krayon::mini;
+
+namespace {
+
+constexpr int element_count = 200;
+
+/// Expression arguments, selections, queries, a bulk loop and a failure
+const char* const script_source =
+    "set_property(id: prefix + index, property: \"label\", value: \"label of \" + prefix + index)\n"
+    "get_property(id: prefix + index, property: \"label\")\n"
+    "set_property(select: \"scene_element_number_1*\", property: \"group\", value: \"first\")\n"
+    "query_elements(property: \"group\", equals: \"first\", limit: 0)\n"
+    "transform(min_x: 0, max_x: 100, operation: \"move\", x: 1)\n"
+    "transform(min_x: 100, operation: \"move\", x: -100)\n"
+    "for i in 0..50 { transform(id: \"scene_element_number_\" + i, operation: \"move\", y: 1) }\n"
+    "get_property(id: \"scene_element_that_is_missing\", property: \"label\")\n";
+
+SealedCommandRegistry make_registry() {
+    CommandRegistry registry;
+    registry.register_command(std::make_shared<builtin_commands::SetPropertyCommand>());
+    registry.register_command(std::make_shared<builtin_commands::GetPropertyCommand>());
+    registry.register_command(std::make_shared<builtin_commands::TransformCommand>());
+    registry.register_command(std::make_shared<builtin_commands::QueryElementsCommand>());
+    return SealedCommandRegistry(registry);
+}
+
+CommandContext make_context() {
+    CommandContext context;
+    auto store = std::make_shared<ElementStore>();
+    for (int i = 0; i < element_count; ++i) {
+        store->create("scene_element_number_" + std::to_string(i), intern("node"), i, 0.0);
+    }
+    context.set_element_store(std::move(store));
+    context.set_variable("prefix", std::string("scene_element_number_"));
+    context.set_variable("index", 7.0);
+    return context;
+}
+
+/// Commands a batch runs, counting every loop iteration
+size_t executed_commands(const CompiledScript& script) {
+    size_t count = 0;
+    for (const CompiledCommand& compiled : script.commands) {
+        count += compiled.loop ? compiled.loop->iterations() * compiled.loop->body.size() : 1;
+    }
+    return count;
+}
+
+bool all_succeeded(const std::vector<CommandResult>& results) {
+    // Only the lookup of the missing element fails.
+    size_t failures = 0;
+    for (const CommandResult& result : results) {
+        failures += !result.success;
+    }
+    return failures == 1 && !results.back().success;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t batches = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000;
+    SealedCommandRegistry registry = make_registry();
+    ScriptCompiler compiler(registry);
+    CompiledScript probe = compiler.compile(script_source);
+    if (!probe.valid) {
+        std::fprintf(stderr, "script does not compile: %s\n", probe.error.c_str());
+        return 1;
+    }
+    double commands = static_cast<double>(executed_commands(probe) * batches);
+
+    // Each run starts with one untimed batch, so columns, indexes and
+    // interned names already exist.
+    CommandContext heap_context = make_context();
+    execute_script(compiler.compile(script_source), heap_context);
+    size_t before = heap_allocations;
+    bool ok = true;
+    for (size_t i = 0; i < batches; ++i) {
+        CompiledScript script = compiler.compile(script_source);
+        ok = all_succeeded(execute_script(script, heap_context)) && ok;
+    }
+    size_t heap_only = heap_allocations - before;
+
+    CommandContext arena_context = make_context();
+    ScriptArena arena;
+    execute_batch_in_arena(compiler, script_source, arena_context, arena);
+    before = heap_allocations;
+    size_t arena_allocations = 0;
+    for (size_t i = 0; i < batches; ++i) {
+        ok = all_succeeded(execute_batch_in_arena(compiler, script_source, arena_context, arena)) &&
+             ok;
+        arena_allocations += arena.last_batch_stats().allocations;
+    }
+    size_t with_arena = heap_allocations - before;
+
+    if (!ok) {
+        std::fprintf(stderr, "unexpected command results\n");
+        return 1;
+    }
+    std::printf("%zu batches of %zu commands\n", batches, executed_commands(probe));
+    std::printf("global heap:    %6.2f heap allocations per command\n",
+                static_cast<double>(heap_only) / commands);
+    std::printf("batch arena:    %6.2f heap + %.2f arena allocations per command\n",
+                static_cast<double>(with_arena) / commands,
+                static_cast<double>(arena_allocations) / commands);
+    if (with_arena >= heap_only) {
+        std::fprintf(stderr, "the arena did not take any allocations off the heap\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+// 64 sessions look up, execute and compile commands through one
+// ConcurrentCommandRegistry while another thread keeps registering and
+// unregistering commands. Checks that every lookup sees a complete
+// version, that no session ever misses a permanent command and that every
+// retired version is reclaimed, then reports the lookup rate. Built with
+// ThreadSanitizer where the compiler supports it.
+//
+//     concurrent_registry_test [iterations per session]    (default 100000)
+
+#include "mini/concurrent_registry.hpp"
+#include "mini/script_compiler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace krayon::mini;
+
+namespace {
+
+constexpr int sessions = 64;
+constexpr int dynamic_commands = 8;
+
+/// `name(value: v)` returns v; its name tells it apart from the others
+class EchoCommand : public SceneCommand, public SlotCommand {
+public:
+    explicit EchoCommand(std::string name) : name(std::move(name)) {}
+
+    std::string get_name() const override { return name; }
+    std::string get_description() const override { return "Return the value argument"; }
+
+    std::vector<Parameter> get_parameters() const override {
+        return {{"value", "number", true, std::monostate(), "Value to return"}};
+    }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext&) override {
+        return CommandResult(true, name, params.at("value"));
+    }
+
+    CommandResult execute_slots(const BoundArguments& args, CommandContext&) override {
+        return CommandResult(true, name, *args.get(0));
+    }
+
+private:
+    std::string name;
+};
+
+std::string dynamic_name(int k) { return "dynamic_" + std::to_string(k); }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 100000;
+
+    CommandRegistry initial;
+    initial.register_command(std::make_shared<EchoCommand>("echo"));
+    ConcurrentCommandRegistry registry(initial);
+
+    std::atomic<int> running{sessions};
+    std::atomic<long> errors{0};
+    std::atomic<long> lookups{0};
+    std::atomic<long> updates{0};
+
+    // Registers and unregisters dynamic_<k> until every session is done.
+    std::thread writer([&] {
+        for (long round = 0; running.load(std::memory_order_relaxed) > 0; ++round) {
+            int k = static_cast<int>(round % dynamic_commands);
+            if ((round / dynamic_commands) % 2 == 0) {
+                registry.register_command(std::make_shared<EchoCommand>(dynamic_name(k)));
+            } else if (!registry.unregister_command(dynamic_name(k))) {
+                errors.fetch_add(1);
+            }
+            updates.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < sessions; ++t) {
+        threads.emplace_back([&, t] {
+            ConcurrentCommandRegistry::Reader reader(registry);
+            CommandContext context;
+            std::map<std::string, MiniValue> params{{"value", static_cast<double>(t)}};
+            long local_errors = 0;
+            for (long i = 0; i < iterations; ++i) {
+                auto pin = reader.pin();
+                SceneCommand* echo = pin.find("echo");
+                if (!echo || echo->execute(params, context).message != "echo") {
+                    ++local_errors;
+                }
+                std::string name = dynamic_name(static_cast<int>(i % dynamic_commands));
+                SceneCommand* dynamic = pin.find(name);
+                if (dynamic && dynamic->get_name() != name) {
+                    ++local_errors;
+                }
+                if (i % 1024 == 0) {
+                    ScriptCompiler compiler(pin.registry());
+                    CompiledScript script = compiler.compile("echo(value: " + std::to_string(t) +
+                                                             ")\n" + (dynamic ? name + "(value: 1)\n"
+                                                                              : std::string()));
+                    std::vector<CommandResult> results =
+                        script.valid ? execute_script(script, context)
+                                     : std::vector<CommandResult>();
+                    if (!script.valid || results.empty() || !results[0].success ||
+                        results[0].return_value != MiniValue(static_cast<double>(t))) {
+                        ++local_errors;
+                    }
+                }
+            }
+            errors.fetch_add(local_errors);
+            lookups.fetch_add(iterations * 2, std::memory_order_relaxed);
+            running.fetch_sub(1);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    writer.join();
+
+    size_t waiting = registry.collect();
+    std::printf("%d sessions, %ld lookups, %ld registry updates in %.3f s\n", sessions,
+                lookups.load(), updates.load(), seconds);
+    std::printf("%.1f ns per lookup (wall clock over all sessions)\n",
+                seconds * 1e9 / static_cast<double>(lookups.load()));
+    if (errors.load() != 0 || waiting != 0) {
+        std::fprintf(stderr, "FAILED: %ld errors, %zu versions not reclaimed\n", errors.load(),
+                     waiting);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Parses every number literal of a generated script with parse_number()
+// and with the string + strtod conversion it replaces, checks that both
+// agree bit for bit, and reports the time per literal.
+//
+//     number_parse_bench [literals]    (default 10000000)
+
+#include "mini/number_parse.hpp"
+#include "mini/token_stream.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace krayon::mini;
+
+namespace {
+
+/// `create_element(type: "node", name: "e", x: <literal>, y: <literal>)`
+/// lines, with coordinates, integers, exponents and long mantissas
+std::string make_script(size_t literals) {
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> coordinate(-1000.0, 1000.0);
+    std::string script;
+    script.reserve(literals * 24);
+    char buffer[64];
+    for (size_t i = 0; i < literals; i += 2) {
+        script += "create_element(type: \"node\", name: \"e\"";
+        for (const char* axis : {", x: ", ", y: "}) {
+            double value = coordinate(random);
+            switch (random() % 4) {
+                case 0: std::snprintf(buffer, sizeof(buffer), "%.3f", std::abs(value)); break;
+                case 1: std::snprintf(buffer, sizeof(buffer), "%d", static_cast<int>(std::abs(value))); break;
+                case 2: std::snprintf(buffer, sizeof(buffer), "%.6e", std::abs(value)); break;
+                default: std::snprintf(buffer, sizeof(buffer), "%.17g", std::abs(value)); break;
+            }
+            script += axis;
+            script += buffer;
+        }
+        script += ")\n";
+    }
+    return script;
+}
+
+std::vector<std::string_view> number_tokens(std::string_view script) {
+    std::vector<std::string_view> numbers;
+    TokenStream tokens(script);
+    for (TokenView token = tokens.next(); token.type != Tokenizer::TokenType::End;
+         token = tokens.next()) {
+        if (token.type == Tokenizer::TokenType::Number) {
+            numbers.push_back(token.text);
+        }
+    }
+    return numbers;
+}
+
+template <typename Parse>
+double seconds_for(const std::vector<std::string_view>& numbers, std::vector<double>& out,
+                   Parse parse) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        out[i] = parse(numbers[i]);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t literals = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    std::string script = make_script(literals);
+    std::vector<std::string_view> numbers = number_tokens(script);
+    if (numbers.size() < literals) {
+        std::fprintf(stderr, "tokenizer found %zu of %zu literals\n", numbers.size(), literals);
+        return 1;
+    }
+
+    std::vector<double> fast(numbers.size());
+    std::vector<double> reference(numbers.size());
+    double fast_seconds = seconds_for(numbers, fast, [](std::string_view text) {
+        return parse_number(text).value_or(-1.0);
+    });
+    double reference_seconds = seconds_for(numbers, reference, [](std::string_view text) {
+        return std::strtod(std::string(text).c_str(), nullptr);
+    });
+
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        if (std::memcmp(&fast[i], &reference[i], sizeof(double)) != 0) {
+            std::fprintf(stderr, "mismatch for %.*s: %.17g != %.17g\n",
+                         static_cast<int>(numbers[i].size()), numbers[i].data(), fast[i],
+                         reference[i]);
+            return 1;
+        }
+    }
+
+    double count = static_cast<double>(numbers.size());
+    std::printf("%zu literals\n", numbers.size());
+    std::printf("parse_number:    %7.2f ns/literal\n", fast_seconds * 1e9 / count);
+    std::printf("string + strtod: %7.2f ns/literal\n", reference_seconds * 1e9 / count);
+    return 0;
+}
@@ -0,0 +1,179 @@
+// Runs scripts of many independent element commands with execute_parallel()
+// and checks that the results, the element store and the variables match a
+// sequential run. Built with ThreadSanitizer where the compiler supports it.
+
+#include "mini/builtin_commands.hpp"
+#include "mini/parallel_executor.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace krayon::mini;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+/// `counter_<k>(value: v)` stores v in the variable `counter_<k>`; declares
+/// that write, so it runs beside element commands
+class SetCounterCommand : public SceneCommand, public SlotCommand, public AccessAware {
+public:
+    explicit SetCounterCommand(int index) : name("counter_" + std::to_string(index)) {}
+
+    std::string get_name() const override { return name; }
+    std::string get_description() const override { return "Set a counter variable"; }
+
+    std::vector<Parameter> get_parameters() const override {
+        return {{"value", "number", true, std::monostate(), "New value"}};
+    }
+
+    CommandResult execute(const std::map<std::string, MiniValue>& params,
+                          CommandContext& context) override {
+        context.set_variable(name, params.at("value"));
+        return CommandResult(true);
+    }
+
+    CommandResult execute_slots(const BoundArguments& args, CommandContext& context) override {
+        context.set_variable(name, *args.get(0));
+        return CommandResult(true);
+    }
+
+    void describe_access(const BoundArguments&, AccessSet& access) const override {
+        access.variable_writes.push_back(intern(name));
+    }
+
+private:
+    std::string name;
+};
+
+SealedCommandRegistry make_registry() {
+    CommandRegistry registry;
+    registry.register_command(std::make_shared<builtin_commands::CreateElementCommand>());
+    registry.register_command(std::make_shared<builtin_commands::DeleteElementCommand>());
+    registry.register_command(std::make_shared<builtin_commands::SetPropertyCommand>());
+    registry.register_command(std::make_shared<builtin_commands::GetPropertyCommand>());
+    registry.register_command(std::make_shared<builtin_commands::TransformCommand>());
+    for (int k = 0; k < 8; ++k) {
+        registry.register_command(std::make_shared<SetCounterCommand>(k));
+    }
+    return SealedCommandRegistry(registry);
+}
+
+std::string make_script(int elements) {
+    std::string script;
+    for (int i = 0; i < elements; ++i) {
+        std::string id = "\"e" + std::to_string(i) + "\"";
+        script += "create_element(type: \"node\", name: " + id + ", x: " + std::to_string(i) + ")\n";
+        script += "counter_" + std::to_string(i % 8) + "(value: " + std::to_string(i) + ")\n";
+    }
+    for (int i = 0; i < elements; ++i) {
+        std::string id = "\"e" + std::to_string(i) + "\"";
+        script += "set_property(id: " + id + ", property: \"p" + std::to_string(i % 7) +
+                  "\", value: " + std::to_string(i) + ")\n";
+        script += "get_property(id: " + id + ", property: \"p" + std::to_string(i % 7) + "\")\n";
+        if (i % 5 == 0) {
+            script += "transform(id: " + id + ", operation: \"move\", x: 1, y: 2)\n";
+        }
+        if (i % 11 == 0) {
+            script += "delete_element(id: " + id + ")\n";
+        }
+    }
+    script += "get_property(id: \"missing\", property: \"p0\")\n";
+    return script;
+}
+
+CommandContext make_context() {
+    CommandContext context;
+    context.set_element_store(std::make_shared<ElementStore>());
+    return context;
+}
+
+void compare(const CommandContext& expected, const CommandContext& actual, const char* run) {
+    const ElementStore& a = *expected.get_element_store();
+    const ElementStore& b = *actual.get_element_store();
+    check(a.size() == b.size(), std::string(run) + ": element count");
+    if (a.size() != b.size()) {
+        return;
+    }
+    for (ElementStore::Row row = 0; row < a.size(); ++row) {
+        check(a.id_at(row) == b.id_at(row), std::string(run) + ": row order");
+        check(a.get_x()[row] == b.get_x()[row] && a.get_y()[row] == b.get_y()[row],
+              std::string(run) + ": position");
+        for (int k = 0; k < 7; ++k) {
+            SymbolId property = intern("p" + std::to_string(k));
+            check(a.get_property(row, property) == b.get_property(row, property),
+                  std::string(run) + ": property value");
+        }
+    }
+    for (int k = 0; k < 8; ++k) {
+        std::string name = "counter_" + std::to_string(k);
+        check(expected.get_variable(name) == actual.get_variable(name),
+              std::string(run) + ": variable " + name);
+    }
+}
+
+/// Row writes to different elements are independent unless they update an index
+void check_row_writes(ScriptCompiler& compiler) {
+    CompiledScript script = compiler.compile(
+        "set_property(id: \"a\", property: \"p0\", value: 1)\n"
+        "set_property(id: \"b\", property: \"p0\", value: 2)\n"
+        "transform(id: \"b\", operation: \"move\", x: 1)\n"
+        "create_element(type: \"node\", name: \"c\")\n");
+    ElementStore store;
+    DependencyGraph graph = build_dependency_graph(script, &store);
+    check(graph.dependency_count[1] == 0, "writes to different elements overlap");
+    check(graph.dependency_count[2] == 1, "writes to one element are ordered");
+    check(graph.dependency_count[3] == 3, "creates wait for every element access");
+
+    store.create_index(intern("p0"), ElementStore::IndexKind::Hash);
+    graph = build_dependency_graph(script, &store);
+    check(graph.dependency_count[1] == 1, "writes to an indexed property are ordered");
+}
+
+}  // namespace
+
+int main() {
+    SealedCommandRegistry registry = make_registry();
+    ScriptCompiler compiler(registry);
+    CompiledScript script = compiler.compile(make_script(2000));
+    check(script.valid, "script compiles: " + script.error);
+    if (!script.valid) {
+        return 1;
+    }
+
+    check_row_writes(compiler);
+
+    CommandContext sequential = make_context();
+    std::vector<CommandResult> expected = execute_script(script, sequential);
+
+    krayon::core::ThreadPool pool(8);
+    for (int run = 0; run < 4; ++run) {
+        CommandContext parallel = make_context();
+        std::vector<CommandResult> actual = execute_parallel(script, parallel, pool);
+        check(actual.size() == expected.size(), "result count");
+        for (size_t i = 0; i < expected.size() && i < actual.size(); ++i) {
+            check(actual[i].success == expected[i].success &&
+                      actual[i].message == expected[i].message &&
+                      actual[i].return_value == expected[i].return_value,
+                  "result of command " + std::to_string(i));
+        }
+        compare(sequential, parallel, "parallel run");
+    }
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("parallel_executor_test: %zu commands match sequential execution\n",
+                expected.size());
+    return 0;
+}